@@ -1,6 +1,9 @@
 #pragma once
 
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 struct Document {
     Document() = default;
@@ -21,3 +24,29 @@ enum class DocumentStatus {
     BANNED,
     REMOVED,
 };
+
+inline std::string_view DocumentStatusToString(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL";
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT";
+    case DocumentStatus::BANNED:
+        return "BANNED";
+    case DocumentStatus::REMOVED:
+        return "REMOVED";
+    }
+    return "ACTUAL";
+}
+
+inline DocumentStatus ParseDocumentStatus(std::string_view text) {
+    for (auto status : { DocumentStatus::ACTUAL,
+                         DocumentStatus::IRRELEVANT,
+                         DocumentStatus::BANNED,
+                         DocumentStatus::REMOVED }) {
+        if (text == DocumentStatusToString(status)) {
+            return status;
+        }
+    }
+    throw std::invalid_argument("Unknown document status " + std::string(text));
+}
@@ -0,0 +1,157 @@
+#include "fuzzy_term_index.h"
+#include "memory_tracking.h"
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+namespace {
+
+const size_t NO_POSITION = std::numeric_limits<size_t>::max();
+
+// FNV-1a строки term без символов на позициях first и second
+uint32_t HashWithout(std::string_view term, size_t first, size_t second) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < term.size(); ++i) {
+        if (i != first && i != second) {
+            hash = (hash ^ static_cast<unsigned char>(term[i])) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// хеши строк, получающихся из term удалением не больше max_edits символов, без повторов
+std::vector<uint32_t> GetDeletionHashes(std::string_view term, int max_edits) {
+    std::vector<uint32_t> hashes{ HashWithout(term, NO_POSITION, NO_POSITION) };
+    if (max_edits >= 1) {
+        for (size_t first = 0; first < term.size(); ++first) {
+            hashes.push_back(HashWithout(term, first, NO_POSITION));
+            if (max_edits >= 2) {
+                for (size_t second = first + 1; second < term.size(); ++second) {
+                    hashes.push_back(HashWithout(term, first, second));
+                }
+            }
+        }
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+}
+
+FuzzyTermIndex::FuzzyTermIndex(int max_edits)
+    : max_edits_(max_edits) {
+    if (max_edits < 0) {
+        throw std::invalid_argument("Invalid fuzzy index edit distance"s);
+    }
+}
+
+int FuzzyTermIndex::GetMaxEdits() const {
+    return max_edits_;
+}
+
+void FuzzyTermIndex::Build(const std::vector<std::string_view>& terms) {
+    TermDictionary<uint8_t> dictionary;
+    std::vector<std::pair<uint32_t, uint32_t>> entries;
+    for (size_t id = 0; id < terms.size(); ++id) {
+        dictionary.Add(terms[id], static_cast<uint8_t>(std::min<size_t>(terms[id].size(), 255)));
+        for (const uint32_t hash : GetDeletionHashes(terms[id], max_edits_)) {
+            entries.emplace_back(hash, static_cast<uint32_t>(id));
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
+    terms_ = std::move(dictionary);
+    hashes_.resize(entries.size());
+    term_ids_.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        hashes_[i] = entries[i].first;
+        term_ids_[i] = entries[i].second;
+    }
+    hashes_.shrink_to_fit();
+    term_ids_.shrink_to_fit();
+    added_hashes_.clear();
+    added_terms_.clear();
+    removed_terms_ = 0;
+}
+
+void FuzzyTermIndex::Add(std::string_view term) {
+    // термин, удалённый и добавленный снова, уже есть в основной части
+    if (terms_.Find(term) != terms_.size()) {
+        return;
+    }
+    const auto [it, inserted] = added_terms_.emplace(term);
+    if (inserted) {
+        for (const uint32_t hash : GetDeletionHashes(term, max_edits_)) {
+            added_hashes_.emplace(hash, &*it);
+        }
+    }
+}
+
+void FuzzyTermIndex::Remove() {
+    ++removed_terms_;
+}
+
+bool FuzzyTermIndex::NeedsRebuild() const {
+    const size_t limit = std::max<size_t>(1024, terms_.size() / 4);
+    return added_terms_.size() > limit || removed_terms_ > limit;
+}
+
+std::vector<FuzzyTermIndex::Match> FuzzyTermIndex::FindMatches(std::string_view word, int max_edits) const {
+    max_edits = std::min(max_edits, max_edits_);
+    std::vector<uint32_t> candidates;
+    std::vector<const std::string*> added_candidates;
+    for (const uint32_t hash : GetDeletionHashes(word, max_edits)) {
+        const auto [first, last] = std::equal_range(hashes_.begin(), hashes_.end(), hash);
+        for (auto it = first; it != last; ++it) {
+            candidates.push_back(term_ids_[it - hashes_.begin()]);
+        }
+        const auto [added_first, added_last] = added_hashes_.equal_range(hash);
+        for (auto it = added_first; it != added_last; ++it) {
+            added_candidates.push_back(it->second);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    std::sort(added_candidates.begin(), added_candidates.end());
+    added_candidates.erase(std::unique(added_candidates.begin(), added_candidates.end()), added_candidates.end());
+
+    // совпадение хеша удаления - только кандидат, расстояние считает автомат
+    const LevenshteinAutomaton automaton(word, max_edits);
+    std::vector<int> states(2 * automaton.GetStateSize());
+    std::vector<Match> result;
+    std::string buffer;
+    for (const uint32_t id : candidates) {
+        const size_t length = terms_.GetValue(id);
+        if (length < 255 && (length + max_edits < word.size() || length > word.size() + max_edits)) {
+            continue;
+        }
+        const std::string_view term = terms_.GetTerm(id, buffer);
+        const int distance = automaton.Match(term, states.data());
+        if (distance >= 0) {
+            result.push_back({ std::string(term), distance });
+        }
+    }
+    for (const std::string* term : added_candidates) {
+        const int distance = automaton.Match(*term, states.data());
+        if (distance >= 0) {
+            result.push_back({ *term, distance });
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const Match& lhs, const Match& rhs) {
+        return std::tie(lhs.distance, lhs.term) < std::tie(rhs.distance, rhs.term);
+    });
+    return result;
+}
+
+size_t FuzzyTermIndex::GetMemoryUsage() const {
+    size_t usage = terms_.GetMemoryUsage()
+        + (hashes_.capacity() + term_ids_.capacity()) * sizeof(uint32_t)
+        + added_hashes_.bucket_count() * sizeof(void*)
+        + added_hashes_.size() * (sizeof(decltype(added_hashes_)::value_type) + 2 * sizeof(void*));
+    for (const std::string& term : added_terms_) {
+        usage += TreeNodeSize<std::string>() + StringHeapSize(term);
+    }
+    return usage;
+}
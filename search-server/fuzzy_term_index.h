@@ -0,0 +1,60 @@
+#pragma once
+
+#include "levenshtein_automaton.h"
+#include "term_dictionary.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Индекс удалений для нечёткого поиска (symmetric delete). Для каждого термина
+// запоминаются хеши строк, получающихся из него удалением до max_edits символов.
+// Если расстояние Левенштейна между словами не больше k, у них есть общая строка
+// с не более чем k удалениями в каждом, поэтому кандидаты для слова запроса -
+// термины с общими хешами удалений, и каждый кандидат проверяется автоматом
+// Левенштейна. Поиск не обходит словарь: при max_edits = 2 на слово длины L
+// приходится 1 + L + L(L-1)/2 двоичных поисков. Цена - столько же хешей на термин.
+//
+// Основная часть неизменна: термины в сжатом словаре, пары (хеш, номер термина)
+// по возрастанию хеша. Новые термины попадают в добавочную часть с хеш-таблицей,
+// удалённые из словаря остаются до перестройки - их отбрасывает вызывающий.
+// NeedsRebuild() сообщает, что пора собрать основную часть заново.
+class FuzzyTermIndex {
+public:
+    struct Match {
+        std::string term;
+        int distance = 0;
+    };
+
+    explicit FuzzyTermIndex(int max_edits);
+
+    int GetMaxEdits() const;
+
+    // заменяет содержимое терминами terms, отсортированными по возрастанию
+    void Build(const std::vector<std::string_view>& terms);
+    // в словаре появился термин
+    void Add(std::string_view term);
+    // из словаря удалён термин
+    void Remove();
+    // добавочная часть или число удалённых терминов выросли до четверти основной
+    bool NeedsRebuild() const;
+
+    // термины на расстоянии не больше max_edits от word, включая само слово,
+    // по возрастанию расстояния, при равном - по алфавиту
+    std::vector<Match> FindMatches(std::string_view word, int max_edits) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    int max_edits_;
+    // значение - длина термина (не больше 255): кандидат отбрасывается по длине без распаковки
+    TermDictionary<uint8_t> terms_;
+    std::vector<uint32_t> hashes_;
+    std::vector<uint32_t> term_ids_;
+
+    std::set<std::string, std::less<>> added_terms_;
+    std::unordered_multimap<uint32_t, const std::string*> added_hashes_;
+    size_t removed_terms_ = 0;
+};
@@ -0,0 +1,164 @@
+#include "ingestion.h"
+#include "bounded_queue.h"
+#include "mapped_file.h"
+
+#include <chrono>
+#include <future>
+
+namespace {
+
+struct PreparedBatch {
+    std::vector<SearchServer::PreparedDocument> documents;
+    size_t errors = 0;
+    std::string first_error;
+};
+
+// пачка строк и обещание её разбора; будущие результаты идут индексатору
+// в порядке чтения, поэтому документы индексируются в порядке корпуса
+struct RecordBatch {
+    std::vector<std::string_view> records;
+    std::promise<PreparedBatch> prepared;
+};
+
+SearchServer::PreparedDocument PrepareRecord(const SearchServer& search_server, std::string_view record) {
+    const int document_id = ParseInt(NextToken(record));
+    const auto status = ParseDocumentStatus(NextToken(record));
+    const auto ratings = ParseRatings(NextToken(record));
+    return search_server.PrepareDocument(document_id, record, status, ratings);
+}
+
+void SplitRecords(std::string_view corpus,
+    size_t batch_size,
+    BoundedQueue<RecordBatch>& records,
+    BoundedQueue<std::future<PreparedBatch>>& ordered) {
+    std::vector<std::string_view> batch;
+    batch.reserve(batch_size);
+    const auto push = [&] {
+        RecordBatch record_batch{ std::move(batch), {} };
+        auto prepared = record_batch.prepared.get_future();
+        records.Push(std::move(record_batch));
+        ordered.Push(std::move(prepared));
+    };
+    while (!corpus.empty()) {
+        const auto newline = corpus.find('\n');
+        auto record = corpus.substr(0, newline);
+        corpus.remove_prefix(newline == corpus.npos ? corpus.size() : newline + 1);
+
+        if (!record.empty() && record.back() == '\r') {
+            record.remove_suffix(1);
+        }
+        if (record.empty()) {
+            continue;
+        }
+        batch.push_back(record);
+        if (batch.size() == batch_size) {
+            push();
+            batch.clear();
+            batch.reserve(batch_size);
+        }
+    }
+    if (!batch.empty()) {
+        push();
+    }
+    records.Close();
+    ordered.Close();
+}
+
+void TokenizeRecords(const SearchServer& search_server, BoundedQueue<RecordBatch>& records) {
+    while (auto batch = records.Pop()) {
+        PreparedBatch result;
+        result.documents.reserve(batch->records.size());
+        for (const auto record : batch->records) {
+            try {
+                result.documents.push_back(PrepareRecord(search_server, record));
+            }
+            catch (const std::exception& e) {
+                if (result.errors++ == 0) {
+                    result.first_error = e.what();
+                }
+            }
+        }
+        batch->prepared.set_value(std::move(result));
+    }
+}
+
+}  // namespace
+
+double IngestionStats::GetDocumentsPerSecond() const {
+    return seconds > 0 ? documents / seconds : 0.0;
+}
+
+double IngestionStats::GetMegabytesPerSecond() const {
+    return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+IngestionStats IngestCorpus(SearchServer& search_server,
+    std::string_view corpus,
+    const IngestionOptions& options) {
+    if (options.tokenizer_threads == 0 || options.batch_size == 0 || options.queue_capacity == 0) {
+        throw std::invalid_argument("Invalid ingestion options"s);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    IngestionStats stats;
+    stats.bytes = corpus.size();
+
+    BoundedQueue<RecordBatch> records(options.queue_capacity);
+    BoundedQueue<std::future<PreparedBatch>> ordered(options.queue_capacity);
+
+    std::thread reader(SplitRecords, corpus, options.batch_size, std::ref(records), std::ref(ordered));
+
+    std::vector<std::thread> tokenizers;
+    for (size_t i = 0; i < options.tokenizer_threads; ++i) {
+        tokenizers.emplace_back(TokenizeRecords, std::cref(search_server), std::ref(records));
+    }
+
+    // индекс не потокобезопасен на запись, поэтому индексирует только вызывающий поток,
+    // пачки - в порядке корпуса: внутренние номера и выбор строки при повторе id не зависят от потоков
+    while (auto prepared = ordered.Pop()) {
+        auto batch = prepared->get();
+        if (batch.errors > 0 && stats.errors == 0) {
+            stats.first_error = std::move(batch.first_error);
+        }
+        stats.errors += batch.errors;
+        for (auto& document : batch.documents) {
+            try {
+                search_server.AddDocument(std::move(document));
+                ++stats.documents;
+            }
+            catch (const std::exception& e) {
+                if (stats.errors++ == 0) {
+                    stats.first_error = e.what();
+                }
+            }
+        }
+    }
+
+    reader.join();
+    for (auto& tokenizer : tokenizers) {
+        tokenizer.join();
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+IngestionStats IngestFile(SearchServer& search_server,
+    const std::string& path,
+    const IngestionOptions& options) {
+    const MappedFile file(path);
+    return IngestCorpus(search_server, file.GetData(), options);
+}
+
+std::ostream& operator<<(std::ostream& out, const IngestionStats& stats) {
+    out << "documents = "s << stats.documents
+        << ", errors = "s << stats.errors
+        << ", MB = "s << stats.bytes / (1024.0 * 1024.0)
+        << ", seconds = "s << stats.seconds
+        << ", docs/s = "s << stats.GetDocumentsPerSecond()
+        << ", MB/s = "s << stats.GetMegabytesPerSecond();
+    if (!stats.first_error.empty()) {
+        out << ", first error: "s << stats.first_error;
+    }
+    return out;
+}
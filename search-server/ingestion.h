@@ -0,0 +1,39 @@
+#pragma once
+
+#include "search_server.h"
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Загрузка корпуса конвейером: чтение -> разбор на слова -> индексация.
+// Одна строка корпуса - один документ в формате "<id> <status> <rating,rating,...|-> <text>".
+// Стадии связаны очередями ограниченной ёмкости, поэтому быстрое чтение
+// не накапливает в памяти больше queue_capacity пачек на стадию.
+
+struct IngestionOptions {
+    size_t tokenizer_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t batch_size = 1024;
+    size_t queue_capacity = 16;
+};
+
+struct IngestionStats {
+    size_t documents = 0;
+    size_t errors = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+    std::string first_error;
+
+    double GetDocumentsPerSecond() const;
+    double GetMegabytesPerSecond() const;
+};
+
+IngestionStats IngestCorpus(SearchServer& search_server,
+    std::string_view corpus,
+    const IngestionOptions& options = {});
+
+// файл отображается в память, записи передаются по конвейеру без копирования
+IngestionStats IngestFile(SearchServer& search_server,
+    const std::string& path,
+    const IngestionOptions& options = {});
+
+std::ostream& operator<<(std::ostream& out, const IngestionStats& stats);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <string_view>
+
+// Автомат Левенштейна для слова word: принимает строки на расстоянии
+// не больше max_edits. Состояние - глубина (число прочитанных символов) и полоса
+// строки матрицы динамического программирования шириной 2 * max_edits + 1 вокруг
+// диагонали: клетки дальше от неё заведомо больше max_edits. Переход стоит
+// O(max_edits), а не O(word.size()), и позволяет бросить строку, как только
+// никакое её продолжение не подойдёт.
+class LevenshteinAutomaton {
+public:
+    LevenshteinAutomaton(std::string_view word, int max_edits)
+        : word_(word)
+        , max_edits_(max_edits)
+        , width_(2 * max_edits + 1) {
+    }
+
+    size_t GetStateSize() const {
+        return static_cast<size_t>(width_) + 1;
+    }
+
+    void Start(int* state) const {
+        state[0] = 0;
+        for (int j = 0; j < width_; ++j) {
+            const int i = j - max_edits_;
+            state[j + 1] = i < 0 || i > static_cast<int>(word_.size()) ? max_edits_ + 1 : std::min(i, max_edits_ + 1);
+        }
+    }
+
+    // переход по символу c; false, если из нового состояния ничего не принять
+    bool Step(const int* from, char c, int* to) const {
+        const int depth = from[0] + 1;
+        const int limit = max_edits_ + 1;
+        const int size = static_cast<int>(word_.size());
+        to[0] = depth;
+        // клетка j полосы - префикс word длины depth - max_edits + j
+        const int* previous = from + 1;
+        int* current = to + 1;
+        int best = limit;
+        for (int j = 0; j < width_; ++j) {
+            const int i = depth - max_edits_ + j;
+            int value = limit;
+            if (i >= 0 && i <= size) {
+                if (i > 0) {
+                    value = previous[j] + (word_[i - 1] == c ? 0 : 1);
+                }
+                if (j + 1 < width_) {
+                    value = std::min(value, previous[j + 1] + 1);
+                }
+                if (j > 0) {
+                    value = std::min(value, current[j - 1] + 1);
+                }
+            }
+            current[j] = std::min(value, limit);
+            best = std::min(best, value);
+        }
+        return best <= max_edits_;
+    }
+
+    // расстояние до word, если строка принята, иначе -1
+    int GetDistance(const int* state) const {
+        const int j = static_cast<int>(word_.size()) - state[0] + max_edits_;
+        if (j < 0 || j >= width_ || state[j + 1] > max_edits_) {
+            return -1;
+        }
+        return state[j + 1];
+    }
+
+    // расстояние от term до word или -1; buffer - 2 * GetStateSize() элементов
+    int Match(std::string_view term, int* buffer) const {
+        const int length_difference = static_cast<int>(term.size()) - static_cast<int>(word_.size());
+        if (length_difference > max_edits_ || -length_difference > max_edits_) {
+            return -1;
+        }
+        int* from = buffer;
+        int* to = buffer + GetStateSize();
+        Start(from);
+        for (const char c : term) {
+            if (!Step(from, c, to)) {
+                return -1;
+            }
+            std::swap(from, to);
+        }
+        return GetDistance(from);
+    }
+
+private:
+    std::string_view word_;
+    int max_edits_;
+    int width_;
+};
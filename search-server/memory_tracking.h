@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+struct MemoryCounter {
+    std::atomic<size_t> bytes{ 0 };
+};
+
+// Аллокатор, который учитывает выделенные байты в MemoryCounter.
+// Без счётчика (конструктор по умолчанию) работает как std::allocator.
+template <typename T>
+class TrackingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    TrackingAllocator() noexcept = default;
+    explicit TrackingAllocator(MemoryCounter* counter) noexcept : counter_(counter) {}
+
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U>& other) noexcept : counter_(other.GetCounter()) {}
+
+    T* allocate(size_t n) {
+        T* result = std::allocator<T>{}.allocate(n);
+        if (counter_) {
+            counter_->bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    void deallocate(T* pointer, size_t n) noexcept {
+        if (counter_) {
+            counter_->bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+        }
+        std::allocator<T>{}.deallocate(pointer, n);
+    }
+
+    MemoryCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    MemoryCounter* counter_ = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const TrackingAllocator<T>& lhs, const TrackingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const TrackingAllocator<T>& lhs, const TrackingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+// оценка размера узла std::map / std::set: цвет и три указателя плюс значение
+template <typename Value>
+constexpr size_t TreeNodeSize() {
+    return 4 * sizeof(void*) + sizeof(Value);
+}
+
+// байты в куче под строку; короткие строки живут внутри объекта
+inline size_t StringHeapSize(const std::string& text) {
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+}
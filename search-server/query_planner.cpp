@@ -0,0 +1,158 @@
+#include "query_planner.h"
+
+#include <chrono>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// среднее время одного запроса в микросекундах после прогрева
+template <typename Query>
+double MeasureMicroseconds(int repetitions, Query query) {
+    query();
+    const auto start = Clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        query();
+    }
+    const std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / repetitions;
+}
+
+// коэффициенты прямой по двум замерам: короткому и длинному запросу
+QueryCostModel::Cost FitCost(double small_items, double small_us, double large_items, double large_us) {
+    QueryCostModel::Cost cost;
+    cost.per_posting_us = std::max(0.0, (large_us - small_us) / (large_items - small_items));
+    cost.fixed_us = std::max(0.0, small_us - cost.per_posting_us * small_items);
+    return cost;
+}
+
+double Estimate(const QueryCostModel::Cost& cost, double items) {
+    return cost.fixed_us + cost.per_posting_us * items;
+}
+
+}  // namespace
+
+std::string_view ExecutionModeToString(ExecutionMode mode) {
+    switch (mode) {
+    case ExecutionMode::SEQUENTIAL:
+        return "seq";
+    case ExecutionMode::PARALLEL:
+        return "par";
+    case ExecutionMode::PARTITIONED:
+        return "partitioned";
+    }
+    return "seq";
+}
+
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan) {
+    return out << ExecutionModeToString(plan.mode)
+        << ": terms "s << plan.term_count
+        << ", postings "s << plan.posting_count
+        << " (max "s << plan.max_posting_count
+        << "), cost seq "s << plan.sequential_cost_us
+        << " us, par "s << plan.parallel_cost_us
+        << " us, partitioned "s << plan.partitioned_cost_us << " us"s;
+}
+
+QueryPlanner::QueryPlanner(SearchServer& search_server, bool calibrate) :
+    search_server_(search_server) {
+    if (calibrate) {
+        Calibrate();
+    }
+}
+
+void QueryPlanner::Calibrate() {
+    // синтетический индекс: "common" во всех документах, "tenth" - в каждом десятом,
+    // "rare" - в каждом тысячном; модель строится по тем же путям выполнения
+    const int document_count = 20000;
+    SearchServer server{ std::vector<std::string>{} };
+    for (int i = 0; i < document_count; ++i) {
+        std::string text = "common w"s + std::to_string(i % 4000);
+        if (i % 10 == 0) {
+            text += " tenth"s;
+        }
+        if (i % 1000 == 0) {
+            text += " rare"s;
+        }
+        server.AddDocument(i, text, DocumentStatus::ACTUAL, { i % 10 });
+    }
+
+    const std::string small_query = "rare"s;
+    const std::string large_query = "common tenth"s;
+    const double small_total = document_count / 1000;
+    const double large_total = document_count + document_count / 10;
+    const double large_max = document_count;
+    const double threads = static_cast<double>(model_.threads);
+
+    const auto measure = [&server](const auto& policy, const std::string& query, int repetitions) {
+        return MeasureMicroseconds(repetitions, [&] {
+            server.FindTopDocuments(policy, query, [](int, DocumentStatus, int) { return true; });
+        });
+    };
+    const PartitionedPolicy partitioned{ model_.threads };
+
+    model_.sequential = FitCost(small_total, measure(std::execution::seq, small_query, 200),
+        large_total, measure(std::execution::seq, large_query, 10));
+    model_.parallel = FitCost(small_total, measure(std::execution::par, small_query, 200),
+        std::max(large_max, large_total / threads), measure(std::execution::par, large_query, 10));
+    model_.partitioned = FitCost(small_total / threads, measure(partitioned, small_query, 200),
+        large_total / threads, measure(partitioned, large_query, 10));
+}
+
+const QueryCostModel& QueryPlanner::GetCostModel() const {
+    return model_;
+}
+
+void QueryPlanner::SetCostModel(const QueryCostModel& model) {
+    model_ = model;
+    model_.threads = std::max<size_t>(1, model_.threads);
+}
+
+QueryPlan QueryPlanner::Plan(std::string_view raw_query) const {
+    return Plan(search_server_.PrepareQuery(raw_query));
+}
+
+QueryPlan QueryPlanner::Plan(const SearchServer::PreparedQuery& query) const {
+    const auto posting_counts = query.GetPostingCounts();
+
+    QueryPlan plan;
+    plan.term_count = posting_counts.size();
+    for (const size_t posting_count : posting_counts) {
+        plan.posting_count += posting_count;
+        plan.max_posting_count = std::max(plan.max_posting_count, posting_count);
+    }
+
+    const double total = static_cast<double>(plan.posting_count);
+    const double threads = static_cast<double>(model_.threads);
+    plan.sequential_cost_us = Estimate(model_.sequential, total);
+    // execution::par делит работу по словам: самый длинный список - нижняя граница
+    plan.parallel_cost_us = Estimate(model_.parallel, std::max<double>(plan.max_posting_count, total / threads));
+    plan.partitioned_cost_us = Estimate(model_.partitioned, total / threads);
+
+    if (model_.threads > 1) {
+        if (plan.parallel_cost_us < plan.sequential_cost_us && plan.parallel_cost_us <= plan.partitioned_cost_us) {
+            plan.mode = ExecutionMode::PARALLEL;
+        }
+        else if (plan.partitioned_cost_us < plan.sequential_cost_us) {
+            plan.mode = ExecutionMode::PARTITIONED;
+        }
+    }
+    return plan;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> QueryPlanner::MatchDocument(std::string_view raw_query,
+    int document_id) const {
+    return search_server_.MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+void QueryPlanner::RemoveDocument(int document_id) {
+    search_server_.RemoveDocument(std::execution::seq, document_id);
+}
+
+std::array<uint64_t, 3> QueryPlanner::GetModeCounts() const {
+    return { mode_counts_[0].load(), mode_counts_[1].load(), mode_counts_[2].load() };
+}
+
+void QueryPlanner::CountMode(ExecutionMode mode) const {
+    ++mode_counts_[static_cast<size_t>(mode)];
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "search_server.h"
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <string_view>
+
+// Выбор способа выполнения запроса по оценке стоимости: короткие запросы
+// быстрее последовательно, длинные списки документов окупают потоки.
+// Стоимость оценивается по длинам списков документов слов запроса (с раскрытиями)
+// линейной моделью, коэффициенты которой замеряются на синтетическом индексе
+// при создании планировщика.
+
+enum class ExecutionMode {
+    SEQUENTIAL,    // std::execution::seq
+    PARALLEL,      // std::execution::par: параллельно по словам запроса
+    PARTITIONED,   // PartitionedPolicy: параллельно по диапазонам документов
+};
+
+std::string_view ExecutionModeToString(ExecutionMode mode);
+
+// время в микросекундах: fixed + per_posting * число элементов списков,
+// которое обрабатывает самый загруженный поток
+struct QueryCostModel {
+    struct Cost {
+        double fixed_us = 0.0;
+        double per_posting_us = 0.0;
+    };
+
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    Cost sequential{ 1.0, 0.05 };
+    Cost parallel{ 20.0, 0.05 };
+    Cost partitioned{ 30.0, 0.05 };
+};
+
+struct QueryPlan {
+    ExecutionMode mode = ExecutionMode::SEQUENTIAL;
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    size_t max_posting_count = 0;
+    double sequential_cost_us = 0.0;
+    double parallel_cost_us = 0.0;
+    double partitioned_cost_us = 0.0;
+};
+
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan);
+
+class QueryPlanner {
+public:
+    // calibrate - замерить модель стоимости сразу (около десятых долей секунды)
+    explicit QueryPlanner(SearchServer& search_server, bool calibrate = true);
+
+    void Calibrate();
+    const QueryCostModel& GetCostModel() const;
+    void SetCostModel(const QueryCostModel& model);
+
+    // план по уже раскрытому запросу; его же затем выполняет FindTopDocuments(plan, query, ...)
+    QueryPlan Plan(const SearchServer::PreparedQuery& query) const;
+    QueryPlan Plan(std::string_view raw_query) const;
+
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const QueryPlan& plan,
+        const SearchServer::PreparedQuery& query,
+        DocumentPredicate document_predicate) const;
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        DocumentPredicate document_predicate) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        DocumentStatus status) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    // модель описывает обработку списков документов при поиске, к сопоставлению
+    // и удалению она не относится: они выполняются последовательно и в GetModeCounts не входят
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
+        int document_id) const;
+    void RemoveDocument(int document_id);
+
+    // сколько запросов FindTopDocuments выполнено каждым способом, по индексу ExecutionMode
+    std::array<uint64_t, 3> GetModeCounts() const;
+
+private:
+    SearchServer& search_server_;
+    QueryCostModel model_;
+    mutable std::array<std::atomic<uint64_t>, 3> mode_counts_{};
+
+    void CountMode(ExecutionMode mode) const;
+};
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> QueryPlanner::FindTopDocuments(const QueryPlan& plan,
+    const SearchServer::PreparedQuery& query,
+    DocumentPredicate document_predicate) const {
+    CountMode(plan.mode);
+    switch (plan.mode) {
+    case ExecutionMode::PARALLEL:
+        return search_server_.FindTopDocuments<ScoringPolicy>(std::execution::par, query, document_predicate);
+    case ExecutionMode::PARTITIONED: {
+        const PartitionedPolicy policy{ model_.threads };
+        return search_server_.FindTopDocuments<ScoringPolicy>(policy, query, document_predicate);
+    }
+    default:
+        return search_server_.FindTopDocuments<ScoringPolicy>(std::execution::seq, query, document_predicate);
+    }
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> QueryPlanner::FindTopDocuments(std::string_view raw_query,
+    DocumentPredicate document_predicate) const {
+    // запрос раскрывается один раз: и для оценки, и для выполнения
+    const auto query = search_server_.PrepareQuery(raw_query);
+    return FindTopDocuments<ScoringPolicy>(Plan(query), query, document_predicate);
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> QueryPlanner::FindTopDocuments(std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(raw_query,
+        [status](int document_id,
+            DocumentStatus document_status,
+            int rating) {
+                return document_status == status;
+        }
+    );
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> QueryPlanner::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(raw_query, DocumentStatus::ACTUAL);
+}
@@ -0,0 +1,592 @@
+#include "query_server.h"
+#include "search_protocol.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+namespace {
+
+const size_t max_events = 64;
+const size_t read_chunk_size = 64 * 1024;
+
+void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void SetNonBlocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ThrowSystemError("fcntl"s);
+    }
+}
+
+void Wake(int event_fd) {
+    const uint64_t one = 1;
+    [[maybe_unused]] auto written = write(event_fd, &one, sizeof(one));
+}
+
+void DrainWake(int event_fd) {
+    uint64_t value;
+    [[maybe_unused]] auto readed = read(event_fd, &value, sizeof(value));
+}
+
+std::string_view StripCommand(std::string_view line, std::string_view& command) {
+    command = NextToken(line);
+    const auto start = line.find_first_not_of(' ');
+    return start == line.npos ? std::string_view{} : line.substr(start);
+}
+
+}  // namespace
+
+QueryServer::QueryServer(SearchServer& search_server, uint16_t port, size_t thread_count,
+    WriteAheadLog* log) :
+    search_server_(search_server), log_(log) {
+    if (thread_count == 0) {
+        throw std::invalid_argument("Query server needs at least one worker thread"s);
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        ThrowSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listen_fd_, SOMAXCONN) < 0) {
+        close(listen_fd_);
+        ThrowSystemError("bind"s);
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+    SetNonBlocking(listen_fd_);
+
+    accept_epoll_fd_ = epoll_create1(0);
+    accept_wake_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (accept_epoll_fd_ < 0 || accept_wake_fd_ < 0) {
+        ThrowSystemError("epoll"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd_;
+    epoll_ctl(accept_epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+    event.data.fd = accept_wake_fd_;
+    epoll_ctl(accept_epoll_fd_, EPOLL_CTL_ADD, accept_wake_fd_, &event);
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->epoll_fd = epoll_create1(0);
+        worker->wake_fd = eventfd(0, EFD_NONBLOCK);
+        if (worker->epoll_fd < 0 || worker->wake_fd < 0) {
+            ThrowSystemError("epoll"s);
+        }
+        event.data.fd = worker->wake_fd;
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wake_fd, &event);
+        if (log_) {
+            worker->durable_event = std::make_shared<DurableEvent>();
+            worker->durable_event->fd = eventfd(0, EFD_NONBLOCK);
+            if (worker->durable_event->fd < 0) {
+                ThrowSystemError("eventfd"s);
+            }
+            event.data.fd = worker->durable_event->fd;
+            epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->durable_event->fd, &event);
+        }
+        workers_.push_back(std::move(worker));
+    }
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        close(worker->epoll_fd);
+        close(worker->wake_fd);
+    }
+    close(accept_epoll_fd_);
+    close(accept_wake_fd_);
+    close(listen_fd_);
+}
+
+QueryServer::DurableEvent::~DurableEvent() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void QueryServer::Run() {
+    for (auto& worker : workers_) {
+        worker->thread = std::thread([this, &worker = *worker] {
+            WorkerLoop(worker);
+        });
+    }
+    AcceptLoop();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void QueryServer::Stop() {
+    running_ = false;
+    Wake(accept_wake_fd_);
+    for (auto& worker : workers_) {
+        Wake(worker->wake_fd);
+    }
+}
+
+uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+std::string QueryServer::ProcessCommand(std::string_view line) {
+    uint64_t log_sequence = 0;
+    auto response = ExecuteCommand(line, log_sequence);
+    if (log_sequence > 0) {
+        try {
+            log_->WaitDurable(log_sequence);
+        }
+        catch (const std::exception& e) {
+            return "ERR "s + e.what();
+        }
+    }
+    return response;
+}
+
+std::string QueryServer::ExecuteCommand(std::string_view line, uint64_t& log_sequence) {
+    log_sequence = 0;
+    std::string_view command;
+    auto arguments = StripCommand(line, command);
+
+    try {
+        if (command == "SEARCH") {
+            std::shared_lock lock(index_mutex_);
+            return ProcessSearch(arguments);
+        }
+        if (command == "STATS") {
+            std::shared_lock lock(index_mutex_);
+            std::string out = "OK "s;
+            AppendStatistics(out, search_server_.GetQueryStatistics(arguments));
+            return out;
+        }
+        if (command == "GSEARCH") {
+            const auto corpus = ParseStatistics(arguments);
+            std::shared_lock lock(index_mutex_);
+            std::string out;
+            AppendDocuments(out, search_server_.FindTopDocuments(std::execution::seq,
+                arguments,
+                [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; },
+                corpus), true);
+            return out;
+        }
+        if (command == "MATCH") {
+            const int document_id = ParseInt(NextToken(arguments));
+            std::shared_lock lock(index_mutex_);
+            const auto [words, status] = search_server_.MatchDocument(arguments, document_id);
+            std::string out = "OK "s;
+            out += DocumentStatusToString(status);
+            for (const auto word : words) {
+                out += ' ';
+                out += word;
+            }
+            return out;
+        }
+        if (command == "ADD") {
+            const int document_id = ParseInt(NextToken(arguments));
+            const auto status = ParseDocumentStatus(NextToken(arguments));
+            const auto ratings = ParseRatings(NextToken(arguments));
+            // разбор на слова - до блокировки индекса
+            auto document = search_server_.PrepareDocument(document_id, arguments, status, ratings);
+            std::unique_lock lock(index_mutex_);
+            // в журнал попадает только то, что индекс примет; если журнал отказал,
+            // индекс не меняется
+            search_server_.CheckDocument(document);
+            if (log_) {
+                log_sequence = log_->LogAddDocument(document_id, arguments, status, ratings);
+            }
+            search_server_.AddDocument(std::move(document));
+            return "OK"s;
+        }
+        if (command == "REMOVE") {
+            const int document_id = ParseInt(NextToken(arguments));
+            std::unique_lock lock(index_mutex_);
+            // удаление неизвестного id ничего не меняет и в журнал не пишется
+            if (!search_server_.HasDocument(document_id)) {
+                return "OK"s;
+            }
+            if (log_) {
+                log_sequence = log_->LogRemoveDocument(document_id);
+            }
+            search_server_.RemoveDocument(document_id);
+            return "OK"s;
+        }
+        if (command == "CHECKPOINT") {
+            if (!log_) {
+                return "ERR Write-ahead log is not enabled"s;
+            }
+            std::unique_lock lock(index_mutex_);
+            log_->Checkpoint(search_server_);
+            return "OK"s;
+        }
+        return "ERR Unknown command "s + std::string(command);
+    }
+    catch (const std::exception& e) {
+        return "ERR "s + e.what();
+    }
+}
+
+std::vector<std::string> QueryServer::ProcessCommands(const std::vector<std::string_view>& lines) {
+    // изменения пачки подтверждаются одним ожиданием журнала в конце
+    std::vector<size_t> logged;
+    uint64_t last_log_sequence = 0;
+    auto responses = ExecuteCommands(lines, logged, last_log_sequence);
+    if (last_log_sequence > 0) {
+        try {
+            log_->WaitDurable(last_log_sequence);
+        }
+        catch (const std::exception& e) {
+            for (const size_t index : logged) {
+                responses[index] = "ERR "s + e.what();
+            }
+        }
+    }
+    return responses;
+}
+
+std::vector<std::string> QueryServer::ExecuteCommands(const std::vector<std::string_view>& lines,
+    std::vector<size_t>& logged, uint64_t& last_log_sequence) {
+    std::vector<std::string> responses(lines.size());
+    logged.clear();
+    last_log_sequence = 0;
+
+    size_t i = 0;
+    while (i < lines.size()) {
+        std::string_view command;
+        StripCommand(lines[i], command);
+        if (command != "SEARCH") {
+            uint64_t log_sequence = 0;
+            responses[i] = ExecuteCommand(lines[i], log_sequence);
+            if (log_sequence > 0) {
+                logged.push_back(i);
+                last_log_sequence = log_sequence;
+            }
+            ++i;
+            continue;
+        }
+
+        size_t batch_end = i + 1;
+        while (batch_end < lines.size()) {
+            StripCommand(lines[batch_end], command);
+            if (command != "SEARCH") {
+                break;
+            }
+            ++batch_end;
+        }
+
+        if (batch_end - i == 1) {
+            responses[i] = ProcessCommand(lines[i]);
+        }
+        else {
+            // исключения из параллельного алгоритма вызвали бы terminate,
+            // поэтому ProcessSearch сам превращает их в ERR
+            std::shared_lock lock(index_mutex_);
+            std::transform(std::execution::par,
+                lines.begin() + i,
+                lines.begin() + batch_end,
+                responses.begin() + i,
+                [this](std::string_view line) {
+                    std::string_view command;
+                    return ProcessSearch(StripCommand(line, command));
+                });
+        }
+        i = batch_end;
+    }
+    return responses;
+}
+
+std::string QueryServer::ProcessSearch(std::string_view query) {
+    try {
+        std::string out;
+        AppendDocuments(out, search_server_.FindTopDocuments(query));
+        return out;
+    }
+    catch (const std::exception& e) {
+        return "ERR "s + e.what();
+    }
+}
+
+void QueryServer::AcceptLoop() {
+    epoll_event events[2];
+    size_t next_worker = 0;
+
+    while (running_) {
+        const int count = epoll_wait(accept_epoll_fd_, events, 2, -1);
+        if (count < 0 && errno != EINTR) {
+            ThrowSystemError("epoll_wait"s);
+        }
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == accept_wake_fd_) {
+                DrainWake(accept_wake_fd_);
+                continue;
+            }
+            while (true) {
+                const int fd = accept(listen_fd_, nullptr, nullptr);
+                if (fd < 0) {
+                    break;
+                }
+                SetNonBlocking(fd);
+                const int enable = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+                Worker& worker = *workers_[next_worker];
+                next_worker = (next_worker + 1) % workers_.size();
+                {
+                    std::lock_guard lock(worker.pending_mutex);
+                    worker.pending.push_back(fd);
+                }
+                Wake(worker.wake_fd);
+            }
+        }
+    }
+}
+
+void QueryServer::WorkerLoop(Worker& worker) {
+    Connections connections;
+    epoll_event events[max_events];
+
+    while (running_) {
+        const int count = epoll_wait(worker.epoll_fd, events, max_events, -1);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == worker.wake_fd) {
+                DrainWake(worker.wake_fd);
+                RegisterPending(worker, connections);
+                continue;
+            }
+            if (worker.durable_event && fd == worker.durable_event->fd) {
+                DrainWake(fd);
+                ReleaseDurable(worker, connections);
+                continue;
+            }
+            const auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+
+            bool alive = (events[i].events & EPOLLERR) == 0;
+            if (alive && !connection.closing && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) {
+                alive = ReadInput(worker, connection);
+            }
+            if (alive) {
+                alive = FlushOutput(worker, connection);
+            }
+            // после EPOLLHUP отправить уже ничего нельзя, отложенные ответы не ждём
+            const bool hang_up = (events[i].events & EPOLLHUP) != 0;
+            if (!alive || (connection.closing && (hang_up || (!connection.want_write && connection.held.empty())))) {
+                CloseConnection(worker, connections, fd);
+            }
+        }
+    }
+
+    for (auto& [fd, _] : connections) {
+        close(fd);
+    }
+}
+
+void QueryServer::RegisterPending(Worker& worker, Connections& connections) {
+    std::vector<int> pending;
+    {
+        std::lock_guard lock(worker.pending_mutex);
+        pending.swap(worker.pending);
+    }
+    for (const int fd : pending) {
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connections.emplace(fd, std::move(connection));
+    }
+}
+
+bool QueryServer::ReadInput(Worker& worker, Connection& connection) {
+    bool peer_closed = false;
+    char buffer[read_chunk_size];
+    while (true) {
+        const ssize_t readed = read(connection.fd, buffer, sizeof(buffer));
+        if (readed > 0) {
+            connection.input.append(buffer, readed);
+            continue;
+        }
+        if (readed == 0) {
+            peer_closed = true;
+        }
+        else if (errno == EINTR) {
+            continue;
+        }
+        else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        break;
+    }
+
+    // все полные строки, накопленные за одно чтение, обрабатываются одной пачкой
+    std::vector<std::string_view> lines;
+    std::string_view input = connection.input;
+    size_t consumed = 0;
+    while (true) {
+        const auto newline = input.find('\n', consumed);
+        if (newline == input.npos) {
+            break;
+        }
+        auto line = input.substr(consumed, newline - consumed);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+        consumed = newline + 1;
+    }
+
+    if (!lines.empty()) {
+        HeldResponses held;
+        held.responses = ExecuteCommands(lines, held.logged, held.log_sequence);
+        QueueResponses(worker, connection, std::move(held));
+    }
+    connection.input.erase(0, consumed);
+
+    if (connection.input.size() > max_line_length_) {
+        HeldResponses held;
+        held.responses.push_back("ERR Line is too long"s);
+        QueueResponses(worker, connection, std::move(held));
+        peer_closed = true;
+    }
+    // после закрытия со стороны клиента дописываем оставшиеся ответы и закрываем
+    connection.closing = peer_closed;
+    return true;
+}
+
+void QueryServer::QueueResponses(Worker& worker, Connection& connection, HeldResponses&& held) {
+    if (held.log_sequence == 0 && connection.held.empty()) {
+        for (const auto& response : held.responses) {
+            connection.output += response;
+            connection.output += '\n';
+        }
+        return;
+    }
+    if (held.log_sequence > 0) {
+        // поток журнала только будит рабочий поток, ответы переносит сам рабочий поток
+        log_->NotifyDurable(held.log_sequence, [event = worker.durable_event](int error) {
+            if (error != 0) {
+                event->failed = true;
+            }
+            Wake(event->fd);
+        });
+    }
+    connection.held.push_back(std::move(held));
+}
+
+void QueryServer::ReleaseDurable(Worker& worker, Connections& connections) {
+    const bool failed = worker.durable_event->failed;
+    const uint64_t durable_sequence = log_->GetDurableSequence();
+    std::vector<int> finished;
+    for (auto& [fd, connection] : connections) {
+        if (connection->held.empty()) {
+            continue;
+        }
+        while (!connection->held.empty()) {
+            auto& held = connection->held.front();
+            if (held.log_sequence > durable_sequence) {
+                if (!failed) {
+                    break;
+                }
+                // после ошибки журнала WaitDurable не ждёт, а бросает исключение
+                try {
+                    log_->WaitDurable(held.log_sequence);
+                }
+                catch (const std::exception& e) {
+                    for (const size_t index : held.logged) {
+                        held.responses[index] = "ERR "s + e.what();
+                    }
+                }
+            }
+            for (const auto& response : held.responses) {
+                connection->output += response;
+                connection->output += '\n';
+            }
+            connection->held.pop_front();
+        }
+        const bool alive = FlushOutput(worker, *connection);
+        if (!alive || (connection->closing && !connection->want_write && connection->held.empty())) {
+            finished.push_back(fd);
+        }
+    }
+    for (const int fd : finished) {
+        CloseConnection(worker, connections, fd);
+    }
+}
+
+bool QueryServer::FlushOutput(Worker& worker, Connection& connection) {
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t written = send(connection.fd,
+            connection.output.data() + connection.output_offset,
+            connection.output.size() - connection.output_offset,
+            MSG_NOSIGNAL);
+        if (written > 0) {
+            connection.output_offset += written;
+            continue;
+        }
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+
+    const bool want_write = connection.output_offset < connection.output.size();
+    if (!want_write) {
+        connection.output.clear();
+        connection.output_offset = 0;
+    }
+    if (want_write != connection.want_write || connection.closing) {
+        epoll_event event{};
+        event.events = (connection.closing ? 0u : uint32_t(EPOLLIN | EPOLLRDHUP)) | (want_write ? uint32_t(EPOLLOUT) : 0u);
+        event.data.fd = connection.fd;
+        epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.want_write = want_write;
+    }
+    return true;
+}
+
+void QueryServer::CloseConnection(Worker& worker, Connections& connections, int fd) {
+    epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
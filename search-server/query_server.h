@@ -0,0 +1,131 @@
+#pragma once
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Сетевой фронтенд поискового сервера: строковый протокол поверх TCP,
+// один поток принимает соединения, рабочие потоки обслуживают их через epoll.
+//
+// Команды (по одной в строке, ответы приходят в порядке команд):
+//   ADD <id> <status> <rating,rating,...|-> <text>  -> OK
+//   REMOVE <id>                                     -> OK
+//   SEARCH <query>                                  -> OK <n> <id> <relevance> <rating> ...
+//   MATCH <id> <query>                              -> OK <status> <word> ...
+// Команды шарда распределённого поиска (search_broker.h):
+//   STATS <query>                                   -> OK <documents> <total length> <n> <term> <df> ...
+//   GSEARCH <documents> <total length> <n> <term> <df> ... <query>
+//                                                   -> как SEARCH, веса слов по переданной статистике,
+//                                                      релевантность без округления
+// С журналом (write_ahead_log.h) ADD и REMOVE проверяются и записываются в журнал до изменения
+// индекса: отклонённые индексом (занятый id, бюджет памяти) и удаления неизвестного id в журнал
+// не попадают, при отказе журнала индекс не меняется. OK отвечается после сброса записи на диск:
+// рабочий поток не ждёт его, а откладывает ответы соединения (и все следующие за ними) до
+// сообщения журнала через eventfd в своём epoll и тем временем обслуживает другие соединения.
+// Изменения разных соединений и подряд идущие команды одного чтения подтверждаются общей fdatasync.
+//   CHECKPOINT                                      -> OK, снимок индекса и новый журнал
+// При ошибке возвращается ERR <message>.
+class QueryServer {
+public:
+    // log - журнал, уже восстановивший search_server, или nullptr
+    QueryServer(SearchServer& search_server, uint16_t port, size_t thread_count,
+        WriteAheadLog* log = nullptr);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // блокирует вызывающий поток до Stop()
+    void Run();
+    void Stop();
+
+    uint16_t GetPort() const;
+
+    // выполняет одну строку протокола; потокобезопасно
+    std::string ProcessCommand(std::string_view line);
+    // выполняет пачку команд, подряд идущие SEARCH выполняются параллельно
+    std::vector<std::string> ProcessCommands(const std::vector<std::string_view>& lines);
+
+private:
+    // ответы на пачку команд, ждущие сброса журнала до записи log_sequence
+    struct HeldResponses {
+        uint64_t log_sequence = 0;
+        std::vector<std::string> responses;
+        // номера ответов на записанные в журнал изменения
+        std::vector<size_t> logged;
+    };
+
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        // идут в output по порядку, когда журнал сбросит их записи
+        std::deque<HeldResponses> held;
+        bool want_write = false;
+        bool closing = false;
+    };
+
+    // eventfd, в который пишет поток журнала; переживает QueryServer,
+    // если журнал вызовет NotifyDurable уже после его остановки
+    struct DurableEvent {
+        int fd = -1;
+        std::atomic<bool> failed{ false };
+        ~DurableEvent();
+    };
+
+    struct Worker {
+        int epoll_fd = -1;
+        int wake_fd = -1;
+        std::shared_ptr<DurableEvent> durable_event;
+        std::mutex pending_mutex;
+        std::vector<int> pending;
+        std::thread thread;
+    };
+
+    using Connections = std::unordered_map<int, std::unique_ptr<Connection>>;
+
+    SearchServer& search_server_;
+    WriteAheadLog* log_;
+    std::shared_mutex index_mutex_;
+
+    int listen_fd_ = -1;
+    int accept_epoll_fd_ = -1;
+    int accept_wake_fd_ = -1;
+    uint16_t port_ = 0;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_{ true };
+
+    static const size_t max_line_length_ = 1 << 20;
+
+    void AcceptLoop();
+    void WorkerLoop(Worker& worker);
+    void RegisterPending(Worker& worker, Connections& connections);
+    bool ReadInput(Worker& worker, Connection& connection);
+    // ставит ответы в очередь соединения, в output - если ждать нечего
+    void QueueResponses(Worker& worker, Connection& connection, HeldResponses&& held);
+    // переносит в output ответы, чьи записи уже на диске (или с ERR после ошибки журнала)
+    void ReleaseDurable(Worker& worker, Connections& connections);
+    bool FlushOutput(Worker& worker, Connection& connection);
+    void CloseConnection(Worker& worker, Connections& connections, int fd);
+
+    // выполняет команду, не дожидаясь сброса журнала;
+    // для записанного в журнал изменения log_sequence - номер записи, иначе 0
+    std::string ExecuteCommand(std::string_view line, uint64_t& log_sequence);
+    // то же для пачки: logged - номера записанных в журнал изменений,
+    // log_sequence - номер последней их записи или 0
+    std::vector<std::string> ExecuteCommands(const std::vector<std::string_view>& lines,
+        std::vector<size_t>& logged, uint64_t& log_sequence);
+    // вызывается под index_mutex_
+    std::string ProcessSearch(std::string_view query);
+};
@@ -1,5 +1,18 @@
 #include "request_queue.h"
 
+RequestQueue::RequestQueue(const SearchServer& search_server,
+    std::chrono::seconds bucket_duration,
+    size_t bucket_count) :
+    search_request(search_server),
+    start_time_(Clock::now()),
+    bucket_duration_(bucket_duration),
+    bucket_count_(bucket_count),
+    buckets_(new Counters[bucket_count]) {
+    if (bucket_duration_.count() <= 0 || bucket_count_ == 0) {
+        throw std::invalid_argument("Invalid request statistics window"s);
+    }
+}
+
 std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status) {
     return AddFindRequest(raw_query, [&status](int document_id, DocumentStatus document_status, int rating) {return document_status == status; });
 }
@@ -8,6 +21,143 @@ std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query) {
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
+void RequestQueue::RecordRequest(bool has_result, std::chrono::microseconds latency) {
+    const int64_t epoch = CurrentEpoch();
+    Advance(epoch);
+
+    Counters& bucket = buckets_[epoch % bucket_count_];
+    const size_t latency_bucket = LatencyBucket(latency);
+
+    // сначала сумма окна, затем интервал: очистка, увидевшая запрос в интервале,
+    // вычитает его из уже увеличенной суммы, и та не уходит ниже нуля
+    window_.requests.fetch_add(1, std::memory_order_relaxed);
+    window_.latency[latency_bucket].fetch_add(1, std::memory_order_relaxed);
+    bucket.requests.fetch_add(1, std::memory_order_release);
+    bucket.latency[latency_bucket].fetch_add(1, std::memory_order_release);
+    if (!has_result) {
+        window_.no_result_requests.fetch_add(1, std::memory_order_relaxed);
+        bucket.no_result_requests.fetch_add(1, std::memory_order_release);
+    }
+}
+
 int RequestQueue::GetNoResultRequests() const {
-    return count_if(requests_.begin(), requests_.end(), [](QueryResult query) {return query.query_result == 0; });
-}
\ No newline at end of file
+    Advance(CurrentEpoch());
+    return static_cast<int>(window_.no_result_requests.load(std::memory_order_relaxed));
+}
+
+uint64_t RequestQueue::GetRequestCount() const {
+    Advance(CurrentEpoch());
+    return window_.requests.load(std::memory_order_relaxed);
+}
+
+RequestQueue::BucketStats RequestQueue::GetWindowStats() const {
+    Advance(CurrentEpoch());
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start_time_).count();
+    const double window = std::chrono::duration<double>(bucket_duration_).count() * bucket_count_;
+    return MakeStats(window_, std::min(elapsed, window));
+}
+
+RequestQueue::BucketStats RequestQueue::GetBucketStats(size_t buckets_ago) const {
+    const int64_t epoch = CurrentEpoch();
+    Advance(epoch);
+    if (buckets_ago >= bucket_count_ || static_cast<int64_t>(buckets_ago) > epoch) {
+        return {};
+    }
+    return MakeStats(buckets_[(epoch - buckets_ago) % bucket_count_],
+        std::chrono::duration<double>(bucket_duration_).count());
+}
+
+int64_t RequestQueue::CurrentEpoch() const {
+    return (Clock::now() - start_time_) / bucket_duration_;
+}
+
+void RequestQueue::Advance(int64_t epoch) const {
+    if (head_epoch_.load(std::memory_order_acquire) >= epoch) {
+        return;
+    }
+    std::lock_guard lock(advance_mutex_);
+    int64_t head = head_epoch_.load(std::memory_order_relaxed);
+    while (head < epoch) {
+        // при долгом простое достаточно очистить последние bucket_count_ интервалов
+        const int64_t next = std::max(head + 1, epoch - static_cast<int64_t>(bucket_count_) + 1);
+        ExpireBucket(next);
+        head_epoch_.store(next, std::memory_order_release);
+        head = next;
+    }
+}
+
+void RequestQueue::ExpireBucket(int64_t epoch) const {
+    Counters& bucket = buckets_[epoch % bucket_count_];
+
+    window_.requests.fetch_sub(bucket.requests.exchange(0, std::memory_order_acquire),
+        std::memory_order_relaxed);
+    window_.no_result_requests.fetch_sub(bucket.no_result_requests.exchange(0, std::memory_order_acquire),
+        std::memory_order_relaxed);
+    for (size_t i = 0; i < latency_bucket_count_; ++i) {
+        window_.latency[i].fetch_sub(bucket.latency[i].exchange(0, std::memory_order_acquire),
+            std::memory_order_relaxed);
+    }
+}
+
+RequestQueue::BucketStats RequestQueue::MakeStats(const Counters& counters, double seconds) const {
+    BucketStats stats;
+    stats.requests = counters.requests.load(std::memory_order_relaxed);
+    stats.no_result_requests = counters.no_result_requests.load(std::memory_order_relaxed);
+    if (stats.requests == 0) {
+        return stats;
+    }
+    stats.qps = seconds > 0 ? stats.requests / seconds : 0.0;
+    stats.no_result_rate = static_cast<double>(stats.no_result_requests) / stats.requests;
+
+    std::array<uint64_t, latency_bucket_count_> histogram;
+    uint64_t total = 0;
+    for (size_t i = 0; i < latency_bucket_count_; ++i) {
+        histogram[i] = counters.latency[i].load(std::memory_order_relaxed);
+        total += histogram[i];
+    }
+
+    const auto percentile = [&histogram, total](double fraction) {
+        if (total == 0) {
+            return std::chrono::microseconds(0);
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < latency_bucket_count_; ++i) {
+            seen += histogram[i];
+            if (seen >= rank) {
+                return std::chrono::microseconds(LatencyBucketValue(i));
+            }
+        }
+        return std::chrono::microseconds(LatencyBucketValue(latency_bucket_count_ - 1));
+    };
+    stats.latency_p50 = percentile(0.50);
+    stats.latency_p90 = percentile(0.90);
+    stats.latency_p99 = percentile(0.99);
+    return stats;
+}
+
+size_t RequestQueue::LatencyBucket(std::chrono::microseconds latency) {
+    const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    if (value < latency_sub_bucket_count_) {
+        return static_cast<size_t>(value);
+    }
+    if (value >> latency_max_exponent_) {
+        return latency_bucket_count_ - 1;
+    }
+    // старший бит value - 2^exponent, следующие latency_sub_bucket_bits_ бит - номер интервала
+    size_t exponent = latency_sub_bucket_bits_;
+    while (value >> (exponent + 1)) {
+        ++exponent;
+    }
+    const size_t shift = exponent - latency_sub_bucket_bits_;
+    return latency_sub_bucket_count_ * (shift + 1) + static_cast<size_t>(value >> shift) - latency_sub_bucket_count_;
+}
+
+int64_t RequestQueue::LatencyBucketValue(size_t bucket) {
+    if (bucket < latency_sub_bucket_count_) {
+        return static_cast<int64_t>(bucket);
+    }
+    const size_t shift = bucket / latency_sub_bucket_count_ - 1;
+    const int64_t lower = static_cast<int64_t>(latency_sub_bucket_count_ + bucket % latency_sub_bucket_count_) << shift;
+    return lower + ((int64_t(1) << shift) - 1) / 2;
+}
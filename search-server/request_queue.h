@@ -1,12 +1,30 @@
 #pragma once
 
 #include "search_server.h"
-#include <deque>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
 class RequestQueue {
 public:
-    RequestQueue(const SearchServer& search_server) :
-        search_request(search_server) {}
+    using Clock = std::chrono::steady_clock;
+
+    struct BucketStats {
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+        double qps = 0.0;
+        double no_result_rate = 0.0;
+        std::chrono::microseconds latency_p50{ 0 };
+        std::chrono::microseconds latency_p90{ 0 };
+        std::chrono::microseconds latency_p99{ 0 };
+    };
+
+    RequestQueue(const SearchServer& search_server,
+        std::chrono::seconds bucket_duration = std::chrono::minutes(1),
+        size_t bucket_count = min_in_day_);
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(std::string_view raw_query,
@@ -15,27 +33,64 @@ public:
         DocumentStatus status);
     std::vector<Document> AddFindRequest(std::string_view raw_query);
 
+    void RecordRequest(bool has_result, std::chrono::microseconds latency);
+
     int GetNoResultRequests() const;
+    uint64_t GetRequestCount() const;
+
+    // статистика за всё окно (bucket_duration * bucket_count)
+    BucketStats GetWindowStats() const;
+    // статистика одного интервала: 0 - текущий, 1 - предыдущий и т.д.
+    BucketStats GetBucketStats(size_t buckets_ago) const;
 
 private:
-    struct QueryResult {
-        bool query_result;
+    // лог-линейная гистограмма задержек (как в HdrHistogram): задержки до 16 мкс
+    // считаются точно, каждый следующий отрезок [2^e, 2^(e+1)) мкс делится на 16 равных
+    // интервалов, поэтому перцентиль отличается от точного не больше чем на 1/32.
+    // Задержки от 2^26 мкс (около 67 с) попадают в последний интервал
+    static const size_t latency_sub_bucket_bits_ = 4;
+    static const size_t latency_sub_bucket_count_ = size_t(1) << latency_sub_bucket_bits_;
+    static const size_t latency_max_exponent_ = 26;
+    static const size_t latency_bucket_count_ =
+        latency_sub_bucket_count_ * (latency_max_exponent_ - latency_sub_bucket_bits_ + 1);
+
+    struct Counters {
+        std::atomic<uint64_t> requests{ 0 };
+        std::atomic<uint64_t> no_result_requests{ 0 };
+        std::array<std::atomic<uint64_t>, latency_bucket_count_> latency{};
     };
+
     const SearchServer& search_request;
-    std::deque<QueryResult> requests_;
+    const Clock::time_point start_time_;
+    const std::chrono::seconds bucket_duration_;
+    const size_t bucket_count_;
+
+    std::unique_ptr<Counters[]> buckets_;
+    // суммы по всем интервалам окна, чтобы чтение не обходило кольцо
+    mutable Counters window_;
+    // номер самого свежего интервала, до которого кольцо уже очищено;
+    // публикуется после очистки интервала, поэтому запись в него не теряется
+    mutable std::atomic<int64_t> head_epoch_{ 0 };
+    // очищает кольцо один поток, раз в bucket_duration_
+    mutable std::mutex advance_mutex_;
+
     const static int min_in_day_ = 1440;
+
+    int64_t CurrentEpoch() const;
+    void Advance(int64_t epoch) const;
+    void ExpireBucket(int64_t epoch) const;
+    BucketStats MakeStats(const Counters& counters, double seconds) const;
+    static size_t LatencyBucket(std::chrono::microseconds latency);
+    // середина интервала гистограммы, мкс
+    static int64_t LatencyBucketValue(size_t bucket);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
+    const auto start = Clock::now();
     std::vector<Document> temp = search_request.FindTopDocuments(raw_query, document_predicate);
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
 
-    QueryResult query;
-    query.query_result = (temp.empty() == false);
-
-    if (!(requests_.size() < min_in_day_)) {
-        requests_.pop_front();
-    }
-    requests_.push_back(query);
+    RecordRequest(!temp.empty(), latency);
     return temp;
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "document.h"
+
+// Политики ранжирования для SearchServer::FindTopDocuments<Policy>.
+// Вклад слова в релевантность документа:
+//   ComputeScore(ComputeTermWeight(index, document_freq) * weight, term_freq, index, length, rating),
+// где weight - множитель раскрытия запроса (нечёткий поиск), term_freq - доля слова
+// в документе, length - число слов документа без стоп-слов. Длины документов и их
+// сумма запоминаются при индексации, поэтому запрос не перечитывает документы.
+
+struct IndexStatistics {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// статистика коллекции для весов слов запроса; при разбиении индекса на шарды
+// складывается по всем шардам, чтобы веса совпадали с единым индексом
+struct CorpusStatistics {
+    int document_count = 0;
+    uint64_t total_document_length = 0;
+    std::map<std::string, size_t, std::less<>> document_freqs;
+
+    void Merge(const CorpusStatistics& other) {
+        document_count += other.document_count;
+        total_document_length += other.total_document_length;
+        for (const auto& [term, document_freq] : other.document_freqs) {
+            document_freqs[term] += document_freq;
+        }
+    }
+
+    IndexStatistics GetIndexStatistics() const {
+        IndexStatistics statistics;
+        statistics.document_count = document_count;
+        if (document_count > 0) {
+            statistics.average_document_length = static_cast<double>(total_document_length) / document_count;
+        }
+        return statistics;
+    }
+};
+
+// порядок выдачи: по релевантности, при равной - по рейтингу, затем по id.
+// Порядок полный, поэтому выдача не зависит от порядка обхода кандидатов
+// (внутренней нумерации, шардов, потоков)
+struct RelevanceOrder {
+    static constexpr double EPSILON = 1e-6;
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+            if (lhs.rating != rhs.rating) {
+                return lhs.rating > rhs.rating;
+            }
+            return lhs.id < rhs.id;
+        }
+        return lhs.relevance > rhs.relevance;
+    }
+};
+
+struct TfIdfScoring : RelevanceOrder {
+    static double ComputeTermWeight(const IndexStatistics& index, size_t document_freq) {
+        return log(index.document_count * 1.0 / document_freq);
+    }
+
+    static double ComputeScore(double term_weight, double term_freq,
+        const IndexStatistics&, int /*document_length*/, int /*rating*/) {
+        return term_freq * term_weight;
+    }
+};
+
+struct Bm25Scoring : RelevanceOrder {
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    static double ComputeTermWeight(const IndexStatistics& index, size_t document_freq) {
+        const double freq = static_cast<double>(document_freq);
+        return log(1.0 + (index.document_count - freq + 0.5) / (freq + 0.5));
+    }
+
+    static double ComputeScore(double term_weight, double term_freq,
+        const IndexStatistics& index, int document_length, int /*rating*/) {
+        const double count = term_freq * document_length;
+        const double length_ratio = index.average_document_length > 0
+            ? document_length / index.average_document_length
+            : 1.0;
+        return term_weight * count * (K1 + 1) / (count + K1 * (1 - B + B * length_ratio));
+    }
+};
+
+// базовая релевантность, умноженная на 1 + BOOST * ln(1 + rating) для положительного рейтинга
+template <typename BaseScoring>
+struct RatingBoostedScoring : BaseScoring {
+    static constexpr double BOOST = 0.1;
+
+    static double ComputeScore(double term_weight, double term_freq,
+        const IndexStatistics& index, int document_length, int rating) {
+        return BaseScoring::ComputeScore(term_weight, term_freq, index, document_length, rating)
+            * (1.0 + BOOST * std::log1p(std::max(rating, 0)));
+    }
+};
@@ -0,0 +1,385 @@
+#include "search_broker.h"
+#include "search_protocol.h"
+#include "search_server.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const size_t read_chunk_size = 64 * 1024;
+
+int GetPollTimeout(Clock::time_point deadline) {
+    const auto now = Clock::now();
+    if (now >= deadline) {
+        return 0;
+    }
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1;
+}
+
+std::string FormatAddress(const ShardAddress& address) {
+    return address.host + ':' + std::to_string(address.port);
+}
+
+void CheckLine(std::string_view text) {
+    if (text.find('\n') != text.npos || text.find('\r') != text.npos) {
+        throw std::invalid_argument("Line breaks are not allowed"s);
+    }
+}
+
+// "ERR <message>" -> std::invalid_argument(message)
+std::string_view CheckResponse(std::string_view response) {
+    if (NextToken(response) != "OK") {
+        const auto start = response.find_first_not_of(' ');
+        throw std::invalid_argument(std::string(start == response.npos ? std::string_view{} : response.substr(start)));
+    }
+    return response;
+}
+
+}  // namespace
+
+ShardAddress ParseShardAddress(std::string_view text) {
+    const auto colon = text.rfind(':');
+    if (colon == text.npos || colon == 0) {
+        throw std::invalid_argument("Shard address must be host:port, got "s + std::string(text));
+    }
+    const int port = ParseInt(text.substr(colon + 1));
+    if (port <= 0 || port > 65535) {
+        throw std::invalid_argument("Invalid shard port "s + std::string(text));
+    }
+    return { std::string(text.substr(0, colon)), static_cast<uint16_t>(port) };
+}
+
+SearchBroker::SearchBroker(std::vector<ShardAddress> shards, BrokerOptions options) :
+    options_(options) {
+    if (shards.empty()) {
+        throw std::invalid_argument("Broker needs at least one shard"s);
+    }
+    for (auto& address : shards) {
+        Shard shard;
+        shard.address = std::move(address);
+        shards_.push_back(std::move(shard));
+    }
+}
+
+SearchBroker::~SearchBroker() {
+    for (auto& shard : shards_) {
+        Disconnect(shard);
+    }
+}
+
+void SearchBroker::AddDocument(int document_id,
+    std::string_view document,
+    DocumentStatus status,
+    const std::vector<int>& ratings) {
+    CheckLine(document);
+    std::string request = "ADD "s + std::to_string(document_id) + ' ';
+    request += DocumentStatusToString(status);
+    request += ' ';
+    if (ratings.empty()) {
+        request += '-';
+    }
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        if (i > 0) {
+            request += ',';
+        }
+        request += std::to_string(ratings[i]);
+    }
+    request += ' ';
+    request += document;
+
+    std::lock_guard lock(mutex_);
+    CheckResponse(ExchangeOne(GetShardIndex(document_id), std::move(request)));
+}
+
+void SearchBroker::RemoveDocument(int document_id) {
+    std::lock_guard lock(mutex_);
+    CheckResponse(ExchangeOne(GetShardIndex(document_id), "REMOVE "s + std::to_string(document_id)));
+}
+
+std::vector<Document> SearchBroker::FindTopDocuments(std::string_view raw_query) {
+    CheckLine(raw_query);
+    std::lock_guard lock(mutex_);
+    return SearchShards(raw_query);
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> SearchBroker::MatchDocument(std::string_view raw_query,
+    int document_id) {
+    CheckLine(raw_query);
+    std::string response;
+    {
+        std::lock_guard lock(mutex_);
+        response = ExchangeOne(GetShardIndex(document_id),
+            "MATCH "s + std::to_string(document_id) + ' ' + std::string(raw_query));
+    }
+    auto fields = CheckResponse(response);
+    const auto status = ParseDocumentStatus(NextToken(fields));
+    std::vector<std::string> words;
+    for (auto word = NextToken(fields); !word.empty(); word = NextToken(fields)) {
+        words.emplace_back(word);
+    }
+    return { words, status };
+}
+
+int SearchBroker::GetDocumentCount() {
+    std::lock_guard lock(mutex_);
+    const auto responses = Exchange(std::vector<std::string>(shards_.size(), "STATS"s));
+    int count = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!responses[i]) {
+            throw std::runtime_error("Shard "s + FormatAddress(shards_[i].address) + " did not respond"s);
+        }
+        auto fields = CheckResponse(*responses[i]);
+        count += ParseStatistics(fields).document_count;
+    }
+    return count;
+}
+
+size_t SearchBroker::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t SearchBroker::GetShardIndex(int document_id) const {
+    return static_cast<unsigned>(document_id) % shards_.size();
+}
+
+uint64_t SearchBroker::GetPartialResultCount() const {
+    return partial_results_;
+}
+
+std::string SearchBroker::ProcessCommand(std::string_view line) {
+    auto arguments = line;
+    const auto command = NextToken(arguments);
+    try {
+        if (command == "SEARCH") {
+            const auto start = arguments.find_first_not_of(' ');
+            std::string out;
+            AppendDocuments(out, FindTopDocuments(start == arguments.npos ? std::string_view{} : arguments.substr(start)));
+            return out;
+        }
+        if (command == "ADD" || command == "REMOVE" || command == "MATCH") {
+            // команда пересылается владельцу документа как есть
+            CheckLine(line);
+            const int document_id = ParseInt(NextToken(arguments));
+            std::lock_guard lock(mutex_);
+            return ExchangeOne(GetShardIndex(document_id), std::string(line));
+        }
+        return "ERR Unknown command "s + std::string(command);
+    }
+    catch (const std::exception& e) {
+        return "ERR "s + e.what();
+    }
+}
+
+std::vector<Document> SearchBroker::SearchShards(std::string_view raw_query) {
+    const std::string query(raw_query);
+    bool partial = false;
+
+    // фаза 1: статистика слов запроса со всех шардов
+    std::vector<std::string> requests(shards_.size(), "STATS "s + query);
+    const auto statistics_responses = Exchange(requests);
+    CorpusStatistics corpus;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        requests[i].clear();
+        if (!statistics_responses[i]) {
+            partial = true;
+            continue;
+        }
+        auto fields = CheckResponse(*statistics_responses[i]);
+        corpus.Merge(ParseStatistics(fields));
+    }
+
+    // фаза 2: поиск с общей статистикой в ответивших шардах
+    std::string search = "GSEARCH "s;
+    AppendStatistics(search, corpus);
+    search += ' ';
+    search += query;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (statistics_responses[i]) {
+            requests[i] = search;
+        }
+    }
+    const auto search_responses = Exchange(requests);
+
+    std::vector<Document> result;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (requests[i].empty()) {
+            continue;
+        }
+        if (!search_responses[i]) {
+            partial = true;
+            continue;
+        }
+        const auto documents = ParseDocuments(*search_responses[i]);
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+
+    if (partial) {
+        if (!options_.allow_partial_results) {
+            throw std::runtime_error("Some shards did not respond"s);
+        }
+        ++partial_results_;
+    }
+
+    const size_t count = std::min(result.size(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(result.begin(), result.begin() + count, result.end(), TfIdfScoring::IsMoreRelevant);
+    result.resize(count);
+    return result;
+}
+
+std::string SearchBroker::ExchangeOne(size_t index, std::string request) {
+    std::vector<std::string> requests(shards_.size());
+    requests[index] = std::move(request);
+    auto responses = Exchange(requests);
+    if (!responses[index]) {
+        throw std::runtime_error("Shard "s + FormatAddress(shards_[index].address) + " did not respond"s);
+    }
+    return std::move(*responses[index]);
+}
+
+std::vector<std::optional<std::string>> SearchBroker::Exchange(const std::vector<std::string>& requests) {
+    const auto deadline = Clock::now() + options_.timeout;
+    std::vector<std::optional<std::string>> responses(shards_.size());
+
+    std::vector<size_t> active;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (requests[i].empty()) {
+            continue;
+        }
+        Shard& shard = shards_[i];
+        if (shard.fd < 0 && !Connect(shard, deadline)) {
+            continue;
+        }
+        shard.input.clear();
+        shard.output = requests[i];
+        shard.output += '\n';
+        shard.output_offset = 0;
+        active.push_back(i);
+    }
+
+    std::vector<pollfd> fds;
+    while (!active.empty()) {
+        const int timeout = GetPollTimeout(deadline);
+        if (timeout == 0) {
+            break;
+        }
+        fds.clear();
+        for (const size_t i : active) {
+            const Shard& shard = shards_[i];
+            const bool want_write = shard.output_offset < shard.output.size();
+            fds.push_back({ shard.fd, static_cast<short>(POLLIN | (want_write ? POLLOUT : 0)), 0 });
+        }
+        const int count = poll(fds.data(), fds.size(), timeout);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        std::vector<size_t> still_active;
+        for (size_t k = 0; k < active.size(); ++k) {
+            Shard& shard = shards_[active[k]];
+            const short events = count > 0 ? fds[k].revents : 0;
+            bool failed = false;
+
+            if (events & POLLOUT) {
+                while (shard.output_offset < shard.output.size()) {
+                    const ssize_t written = send(shard.fd,
+                        shard.output.data() + shard.output_offset,
+                        shard.output.size() - shard.output_offset,
+                        MSG_NOSIGNAL);
+                    if (written > 0) {
+                        shard.output_offset += written;
+                        continue;
+                    }
+                    failed = written == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+                    break;
+                }
+            }
+            if (!failed && (events & (POLLIN | POLLHUP | POLLERR))) {
+                char buffer[read_chunk_size];
+                while (true) {
+                    const ssize_t readed = recv(shard.fd, buffer, sizeof(buffer), 0);
+                    if (readed > 0) {
+                        shard.input.append(buffer, readed);
+                        continue;
+                    }
+                    failed = readed == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+                    break;
+                }
+            }
+
+            const auto newline = shard.input.find('\n');
+            if (newline != shard.input.npos) {
+                responses[active[k]] = shard.input.substr(0, newline);
+                shard.input.erase(0, newline + 1);
+            }
+            else if (failed) {
+                Disconnect(shard);
+            }
+            else {
+                still_active.push_back(active[k]);
+            }
+        }
+        active.swap(still_active);
+    }
+
+    // поздний ответ перепутал бы следующие запросы, поэтому соединение закрываем
+    for (const size_t i : active) {
+        Disconnect(shards_[i]);
+    }
+    return responses;
+}
+
+bool SearchBroker::Connect(Shard& shard, Clock::time_point deadline) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(shard.address.host.c_str(), std::to_string(shard.address.port).c_str(), &hints, &addresses) != 0) {
+        return false;
+    }
+
+    for (addrinfo* address = addresses; address != nullptr && shard.fd < 0; address = address->ai_next) {
+        const int fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        bool connected = connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS) {
+            pollfd pending{ fd, POLLOUT, 0 };
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = poll(&pending, 1, GetPollTimeout(deadline)) == 1
+                && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0
+                && error == 0;
+        }
+        if (!connected) {
+            close(fd);
+            continue;
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        shard.fd = fd;
+    }
+    freeaddrinfo(addresses);
+    return shard.fd >= 0;
+}
+
+void SearchBroker::Disconnect(Shard& shard) {
+    if (shard.fd >= 0) {
+        close(shard.fd);
+        shard.fd = -1;
+    }
+    shard.input.clear();
+    shard.output.clear();
+    shard.output_offset = 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "document.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Брокер распределённого поиска: документы разложены по процессам-шардам
+// (tools/query_server_main.cpp) по id документа, брокер общается с ними
+// строковым протоколом QueryServer.
+// ADD/REMOVE/MATCH уходят шарду-владельцу. Запрос выполняется в две фазы:
+// STATS собирает со всех шардов число документов и документные частоты слов,
+// GSEARCH ищет в каждом шарде с общей статистикой, поэтому IDF совпадает
+// с единым индексом; лучшие документы шардов сливаются в порядке релевантности.
+// Методы брокера выполняются по одному.
+
+struct ShardAddress {
+    std::string host;
+    uint16_t port = 0;
+};
+
+// "host:port"
+ShardAddress ParseShardAddress(std::string_view text);
+
+struct BrokerOptions {
+    // ожидание ответа шарда на каждую фазу запроса
+    std::chrono::milliseconds timeout{ 1000 };
+    // без ответа части шардов запрос возвращает документы остальных,
+    // иначе бросает std::runtime_error
+    bool allow_partial_results = true;
+};
+
+class SearchBroker {
+public:
+    explicit SearchBroker(std::vector<ShardAddress> shards, BrokerOptions options = {});
+    ~SearchBroker();
+
+    SearchBroker(const SearchBroker&) = delete;
+    SearchBroker& operator=(const SearchBroker&) = delete;
+
+    // ошибка шарда - std::invalid_argument, нет ответа - std::runtime_error
+    // (после тайм-аута изменение могло как примениться, так и нет)
+    void AddDocument(int document_id,
+        std::string_view document,
+        DocumentStatus status,
+        const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query);
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query,
+        int document_id);
+
+    int GetDocumentCount();
+    size_t GetShardCount() const;
+    size_t GetShardIndex(int document_id) const;
+    // запросы, в ответ на которые ответила только часть шардов
+    uint64_t GetPartialResultCount() const;
+
+    // строка протокола QueryServer (ADD/REMOVE/SEARCH/MATCH) -> ответ
+    std::string ProcessCommand(std::string_view line);
+
+private:
+    struct Shard {
+        ShardAddress address;
+        int fd = -1;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+    };
+
+    const BrokerOptions options_;
+    std::vector<Shard> shards_;
+    std::mutex mutex_;
+    std::atomic<uint64_t> partial_results_{ 0 };
+
+    // отправляет requests[i] шарду i (пустой - шард не участвует) и ждёт ответы
+    // не дольше options_.timeout; nullopt - ответа нет, соединение закрывается
+    std::vector<std::optional<std::string>> Exchange(const std::vector<std::string>& requests);
+    std::string ExchangeOne(size_t index, std::string request);
+
+    bool Connect(Shard& shard, std::chrono::steady_clock::time_point deadline);
+    static void Disconnect(Shard& shard);
+
+    std::vector<Document> SearchShards(std::string_view raw_query);
+};
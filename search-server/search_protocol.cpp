@@ -0,0 +1,93 @@
+#include "search_protocol.h"
+#include "string_processing.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+uint64_t ParseUnsigned(std::string_view text) {
+    uint64_t value = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number "s + std::string(text));
+    }
+    return value;
+}
+
+}  // namespace
+
+void AppendDocuments(std::string& out, const std::vector<Document>& documents, bool exact) {
+    out += "OK "s;
+    out += std::to_string(documents.size());
+    char buffer[32];
+    for (const Document& document : documents) {
+        std::snprintf(buffer, sizeof(buffer), exact ? "%.17g" : "%.6g", document.relevance);
+        out += ' ';
+        out += std::to_string(document.id);
+        out += ' ';
+        out += buffer;
+        out += ' ';
+        out += std::to_string(document.rating);
+    }
+}
+
+std::vector<Document> ParseDocuments(std::string_view response) {
+    if (NextToken(response) != "OK") {
+        const auto start = response.find_first_not_of(' ');
+        throw std::invalid_argument(std::string(start == response.npos ? std::string_view{} : response.substr(start)));
+    }
+    const int count = ParseInt(NextToken(response));
+    std::vector<Document> documents;
+    documents.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int id = ParseInt(NextToken(response));
+        const double relevance = ParseDouble(NextToken(response));
+        const int rating = ParseInt(NextToken(response));
+        documents.emplace_back(id, relevance, rating);
+    }
+    return documents;
+}
+
+void AppendStatistics(std::string& out, const CorpusStatistics& statistics) {
+    out += std::to_string(statistics.document_count);
+    out += ' ';
+    out += std::to_string(statistics.total_document_length);
+    out += ' ';
+    out += std::to_string(statistics.document_freqs.size());
+    for (const auto& [term, document_freq] : statistics.document_freqs) {
+        out += ' ';
+        out += term;
+        out += ' ';
+        out += std::to_string(document_freq);
+    }
+}
+
+CorpusStatistics ParseStatistics(std::string_view& text) {
+    CorpusStatistics statistics;
+    statistics.document_count = ParseInt(NextToken(text));
+    statistics.total_document_length = ParseUnsigned(NextToken(text));
+    const int term_count = ParseInt(NextToken(text));
+    for (int i = 0; i < term_count; ++i) {
+        const auto term = NextToken(text);
+        if (term.empty()) {
+            throw std::invalid_argument("Truncated term statistics"s);
+        }
+        statistics.document_freqs[std::string(term)] = ParseUnsigned(NextToken(text));
+    }
+    return statistics;
+}
+
+double ParseDouble(std::string_view text) {
+    const std::string value(text);
+    char* end = nullptr;
+    const double result = std::strtod(value.c_str(), &end);
+    if (value.empty() || end != value.c_str() + value.size()) {
+        throw std::invalid_argument("Invalid number "s + value);
+    }
+    return result;
+}
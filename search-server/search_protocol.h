@@ -0,0 +1,23 @@
+#pragma once
+
+#include "document.h"
+#include "scoring.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Форматирование и разбор полей строкового протокола QueryServer,
+// общие для сервера шарда и брокера (search_broker.h).
+
+// "OK <n> <id> <relevance> <rating> ...";
+// exact - релевантность без потери точности, для слияния ответов шардов
+void AppendDocuments(std::string& out, const std::vector<Document>& documents, bool exact = false);
+// разбирает ответ AppendDocuments, для "ERR <message>" бросает std::invalid_argument(message)
+std::vector<Document> ParseDocuments(std::string_view response);
+
+// "<document_count> <total_length> <n> <term> <document_freq> ..."
+void AppendStatistics(std::string& out, const CorpusStatistics& statistics);
+// отрезает от text поля AppendStatistics
+CorpusStatistics ParseStatistics(std::string_view& text);
+
+double ParseDouble(std::string_view text);
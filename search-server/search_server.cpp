@@ -1,101 +1,184 @@
+#include <limits>
 #include <numeric>
+#include <unordered_set>
+#include <utility>
 #include "search_server.h"
 
+SearchServer::SearchServer(const SearchServer& other)
+    : stop_words_(other.stop_words_)
+    , stop_words_memory_(other.stop_words_memory_)
+    , max_prefix_expansion_(other.max_prefix_expansion_) {
+    for (const auto& [internal_id, _] : other.docs_ids_to_word_freqs_) {
+        AddDocument(other.ExtractDocument(internal_id));
+    }
+    SetFuzzyOptions(other.fuzzy_options_);
+    memory_budget_ = other.memory_budget_;
+}
+
 void SearchServer::AddDocument(int document_id,
     std::string_view document,
     DocumentStatus status,
     const std::vector<int>& ratings) {
+    AddDocument(PrepareDocument(document_id, document, status, ratings));
+}
 
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
-        throw std::invalid_argument("Invalid document ID"s);
-    }
-
-    auto [doc_id_, doc_data_] = documents_.emplace(document_id,
-        DocumentData{
-            std::string(document),
-            ComputeAverageRating(ratings),
-            status
+void SearchServer::AddDocument(PreparedDocument&& document) {
+    CheckDocument(document);
+    const int document_id = document.id;
+
+    const int internal_id = static_cast<int>(documents_.size());
+    const auto& document_data = documents_.emplace_back(DocumentData{
+            std::move(document.text),
+            document_id,
+            document.rating,
+            document.status,
+            document.length
         });
+    internal_ids_.emplace(document_id, internal_id);
+    total_document_length_ += document.length;
     document_ids_.insert(document_id);
+    memory_->document_store.bytes += StringHeapSize(document_data.data_string_);
+
+    const std::string_view text = document_data.data_string_;
+    auto& word_freqs = docs_ids_to_word_freqs_.try_emplace(internal_id,
+        WordFrequencies::allocator_type(&memory_->forward_index)).first->second;
+    for (const auto& [offset, length, freq] : document.words) {
+        const auto word = text.substr(offset, length);
+        const auto [entry, inserted] = word_to_document_freqs_.try_emplace(word,
+            Postings::allocator_type(&memory_->postings));
+        entry->second[internal_id] += freq;
+        word_freqs[word] += freq;
+        if (inserted && fuzzy_index_) {
+            fuzzy_index_->Add(word);
+        }
+    }
+    if (fuzzy_index_ && fuzzy_index_->NeedsRebuild()) {
+        RebuildFuzzyIndex();
+    }
+}
+
+SearchServer::PreparedDocument SearchServer::PrepareDocument(int document_id,
+    std::string_view document,
+    DocumentStatus status,
+    const std::vector<int>& ratings) const {
+
+    if (document_id < 0) {
+        throw std::invalid_argument("Invalid document ID"s);
+    }
 
-    const auto words = SplitIntoWordsNoStop(doc_id_->second.data_string_);
+    PreparedDocument result;
+    result.id = document_id;
+    result.text = std::string(document);
+    result.rating = ComputeAverageRating(ratings);
+    result.status = status;
 
+    auto words = SplitIntoWordsNoStop(result.text);
+    result.length = static_cast<int>(words.size());
     const double inv_word_count = 1.0 / words.size();
 
-    for (auto word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        docs_ids_to_word_freqs_[document_id][word] += inv_word_count;
+    std::sort(words.begin(), words.end());
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (i > 0 && words[i] == words[i - 1]) {
+            result.words.back().freq += inv_word_count;
+        }
+        else {
+            result.words.push_back({ static_cast<size_t>(words[i].data() - result.text.data()),
+                                     words[i].size(),
+                                     inv_word_count });
+        }
     }
+    return result;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-    DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, status);
+void SearchServer::CheckDocument(const PreparedDocument& document) const {
+    if ((document.id < 0) || (internal_ids_.count(document.id) > 0)) {
+        throw std::invalid_argument("Invalid document ID"s);
+    }
+    CheckMemoryBudget(document);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&,
-    std::string_view raw_query,
-    DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq,
-        raw_query,
-        [status](int document_id,
-            DocumentStatus document_status,
-            int rating) {
-                return document_status == status;
-        }
-    );
+bool SearchServer::HasDocument(int document_id) const {
+    return internal_ids_.count(document_id) > 0;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&,
-    std::string_view raw_query,
-    DocumentStatus status) const {
-    return FindTopDocuments(std::execution::par,
-        raw_query,
-        [status](int document_id,
-            DocumentStatus document_status,
-            int rating) {
-                return document_status == status;
-        }
-    );
+int SearchServer::GetDocumentCount() const {
+    return document_ids_.size();
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    return FindTopDocuments(std::execution::seq,
-        raw_query,
-        DocumentStatus::ACTUAL);
+int SearchServer::GetInternalId(int document_id) const {
+    const auto it = internal_ids_.find(document_id);
+    if (it == internal_ids_.end()) {
+        throw std::out_of_range("Document ID doesn't exist"s);
+    }
+    return it->second;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&,
-    std::string_view raw_query) const {
-    return FindTopDocuments(std::execution::seq,
-        raw_query,
-        DocumentStatus::ACTUAL);
+SearchServer::PreparedQuery SearchServer::PrepareQuery(std::string_view raw_query) const {
+    const auto query = ParseQuery(raw_query);
+    PreparedQuery result;
+    result.plus_postings_ = CollectPostings(query.plus_words, query.plus_prefixes, true);
+    result.minus_postings_ = CollectPostings(query.minus_words, query.minus_prefixes, false);
+    return result;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&,
-    std::string_view raw_query) const {
-    return FindTopDocuments(std::execution::par,
-        raw_query,
-        DocumentStatus::ACTUAL);
+std::vector<size_t> SearchServer::PreparedQuery::GetPostingCounts() const {
+    std::vector<size_t> counts;
+    counts.reserve(plus_postings_.size());
+    for (const auto& weighted : plus_postings_) {
+        counts.push_back(weighted.postings->size());
+    }
+    return counts;
 }
 
-int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+CorpusStatistics SearchServer::GetQueryStatistics(std::string_view raw_query) const {
+    const auto query = ParseQuery(raw_query);
+    CorpusStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    statistics.total_document_length = total_document_length_;
+    for (const auto& weighted : CollectPostings(query.plus_words, query.plus_prefixes, true)) {
+        statistics.document_freqs.emplace(weighted.term, weighted.postings->size());
+    }
+    return statistics;
+}
+
+size_t SearchServer::GetDocumentFreq(const WeightedPostings& weighted, const CorpusStatistics* corpus) {
+    if (corpus) {
+        const auto it = corpus->document_freqs.find(weighted.term);
+        if (it != corpus->document_freqs.end()) {
+            return it->second;
+        }
+    }
+    return weighted.postings->size();
 }
 
-std::set<int> ::const_iterator SearchServer::begin() const {
+IndexStatistics SearchServer::GetIndexStatistics() const {
+    IndexStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    if (statistics.document_count > 0) {
+        statistics.average_document_length = static_cast<double>(total_document_length_) / statistics.document_count;
+    }
+    return statistics;
+}
+
+SearchServer::DocumentIds::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-std::set<int> ::const_iterator SearchServer::end() const {
+SearchServer::DocumentIds::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double> emptyes;
-    return (!docs_ids_to_word_freqs_.count(document_id))
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
+    static const WordFrequencies emptyes;
+    const auto internal_id = internal_ids_.find(document_id);
+    return (internal_id == internal_ids_.end())
         ? emptyes
-        : docs_ids_to_word_freqs_.at(document_id);
+        : docs_ids_to_word_freqs_.at(internal_id->second);
+}
+
+SearchServer::StoredDocument SearchServer::GetStoredDocument(int document_id) const {
+    const auto& document = documents_[GetInternalId(document_id)];
+    return { document.data_string_, document.rating, document.status };
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -106,32 +189,226 @@ void SearchServer::RemoveDocument(int document_id) {
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&,
     int document_id) {
 
-    if (document_ids_.find(document_id) != document_ids_.end()) {
-        for (auto& [word, _] : docs_ids_to_word_freqs_[document_id]) {
-            auto erase_word = word_to_document_freqs_[word].find(document_id);
+    const auto internal_id = internal_ids_.find(document_id);
+    if (internal_id != internal_ids_.end()) {
+        for (auto& [word, _] : docs_ids_to_word_freqs_[internal_id->second]) {
+            auto erase_word = word_to_document_freqs_[word].find(internal_id->second);
             word_to_document_freqs_[word].erase(erase_word);
         }
     }
 
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    docs_ids_to_word_freqs_.erase(document_id);
+    EraseDocument(document_id);
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
 
-    std::vector<std::string_view> bin(docs_ids_to_word_freqs_.at(document_id).size());
-    std::transform(std::execution::par, docs_ids_to_word_freqs_.at(document_id).begin(), docs_ids_to_word_freqs_.at(document_id).end(), bin.begin(), [](auto word_freq) {
+    const int internal_id = internal_ids_.at(document_id);
+    std::vector<std::string_view> bin(docs_ids_to_word_freqs_.at(internal_id).size());
+    std::transform(std::execution::par, docs_ids_to_word_freqs_.at(internal_id).begin(), docs_ids_to_word_freqs_.at(internal_id).end(), bin.begin(), [](auto word_freq) {
         return word_freq.first;
         });
 
-    std::for_each(std::execution::par, bin.begin(), bin.end(), [this, document_id](const auto& word) {
-        word_to_document_freqs_.at(word).erase(document_id);
+    std::for_each(std::execution::par, bin.begin(), bin.end(), [this, internal_id](const auto& word) {
+        word_to_document_freqs_.at(word).erase(internal_id);
         });
 
-    documents_.erase(document_id);
+    EraseDocument(document_id);
+}
+
+void SearchServer::EraseDocument(int document_id) {
+    const auto internal_id = internal_ids_.find(document_id);
+    if (internal_id == internal_ids_.end()) {
+        return;
+    }
+    DocumentData& document = documents_[internal_id->second];
+
+    // ключи словаря ссылаются на текст документа, добавившего слово первым:
+    // пустые списки удаляем, остальные ключи переносим в текст оставшегося документа
+    const std::string_view text = document.data_string_;
+    for (const auto& [word, _] : docs_ids_to_word_freqs_.at(internal_id->second)) {
+        const auto entry = word_to_document_freqs_.find(word);
+        if (entry->second.empty()) {
+            word_to_document_freqs_.erase(entry);
+            if (fuzzy_index_) {
+                fuzzy_index_->Remove();
+            }
+        }
+        else if (entry->first.data() >= text.data() && entry->first.data() < text.data() + text.size()) {
+            auto node = word_to_document_freqs_.extract(entry);
+            const int owner_id = node.mapped().begin()->first;
+            node.key() = docs_ids_to_word_freqs_.at(owner_id).find(word)->first;
+            word_to_document_freqs_.insert(std::move(node));
+        }
+    }
+
+    // номер остаётся пустым до ReorderDocuments
+    memory_->document_store.bytes -= StringHeapSize(document.data_string_);
+    total_document_length_ -= document.length;
+    std::string().swap(document.data_string_);
+    docs_ids_to_word_freqs_.erase(internal_id->second);
+    internal_ids_.erase(internal_id);
     document_ids_.erase(document_id);
-    docs_ids_to_word_freqs_.erase(document_id);
+    if (fuzzy_index_ && fuzzy_index_->NeedsRebuild()) {
+        RebuildFuzzyIndex();
+    }
+
+    // пустых номеров больше, чем документов: перенумеровываем в прежнем порядке.
+    // Перестройка затрагивает не больше документов, чем удалено с прошлой,
+    // поэтому в среднем на удаление приходится не больше одного переиндексированного документа
+    const size_t holes = documents_.size() - internal_ids_.size();
+    if (holes > internal_ids_.size() && (holes >= MIN_COMPACTION_HOLES || internal_ids_.empty())) {
+        ReorderDocuments(DocumentOrder::INSERTION);
+    }
+}
+
+void SearchServer::ReorderDocuments(DocumentOrder order) {
+    // живые документы в текущем порядке внутренних номеров
+    std::vector<int> internal_order;
+    internal_order.reserve(docs_ids_to_word_freqs_.size());
+    for (const auto& [internal_id, _] : docs_ids_to_word_freqs_) {
+        internal_order.push_back(internal_id);
+    }
+
+    if (order == DocumentOrder::RATING) {
+        std::stable_sort(internal_order.begin(), internal_order.end(), [this](int lhs, int rhs) {
+            return documents_[lhs].rating > documents_[rhs].rating;
+        });
+    }
+    else if (order == DocumentOrder::CONTENT) {
+        // два минимальных хеша слов документа (MinHash): у документов с большой
+        // долей общих слов они чаще совпадают, поэтому сортировка сближает похожие
+        std::vector<std::pair<size_t, size_t>> signatures(documents_.size());
+        for (const int internal_id : internal_order) {
+            auto& [first, second] = signatures[internal_id];
+            first = second = std::numeric_limits<size_t>::max();
+            for (const auto& [word, _] : docs_ids_to_word_freqs_.at(internal_id)) {
+                const size_t hash = std::hash<std::string_view>{}(word);
+                first = std::min(first, hash);
+                second = std::min(second, static_cast<size_t>((hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ull));
+            }
+        }
+        std::stable_sort(internal_order.begin(), internal_order.end(), [&signatures](int lhs, int rhs) {
+            return signatures[lhs] < signatures[rhs];
+        });
+    }
+
+    // документы переносятся в разобранном виде: слова - смещениями в тексте,
+    // поэтому освобождение прежнего текста не портит ключи
+    std::vector<PreparedDocument> documents;
+    documents.reserve(internal_order.size());
+    for (const int internal_id : internal_order) {
+        documents.push_back(ExtractDocument(internal_id));
+        DocumentData& data = documents_[internal_id];
+        memory_->document_store.bytes -= StringHeapSize(data.data_string_);
+        std::string().swap(data.data_string_);
+    }
+
+    word_to_document_freqs_.clear();
+    docs_ids_to_word_freqs_.clear();
+    // shrink_to_fit у deque оставляет разросшуюся таблицу блоков
+    DocumentStore(documents_.get_allocator()).swap(documents_);
+    internal_ids_.clear();
+    document_ids_.clear();
+    total_document_length_ = 0;
+
+    // объём индекса не растёт, бюджет памяти здесь не проверяем;
+    // набор слов тот же, поэтому индекс нечёткого поиска не меняется
+    const size_t memory_budget = std::exchange(memory_budget_, 0);
+    auto fuzzy_index = std::move(fuzzy_index_);
+    for (auto& document : documents) {
+        AddDocument(std::move(document));
+    }
+    memory_budget_ = memory_budget;
+    fuzzy_index_ = std::move(fuzzy_index);
+}
+
+SearchServer::PreparedDocument SearchServer::ExtractDocument(int internal_id) const {
+    const DocumentData& data = documents_[internal_id];
+    PreparedDocument document;
+    document.id = data.id;
+    document.text = data.data_string_;
+    document.length = data.length;
+    document.rating = data.rating;
+    document.status = data.status;
+    const std::string_view text = data.data_string_;
+    for (const auto& [word, freq] : docs_ids_to_word_freqs_.at(internal_id)) {
+        document.words.push_back({ static_cast<size_t>(word.data() - text.data()), word.size(), freq });
+    }
+    return document;
+}
+
+size_t SearchServer::MemoryUsage::GetTotal() const {
+    return dictionary + postings + forward_index + document_store + stop_words;
+}
+
+SearchServer::MemoryUsage SearchServer::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.dictionary = memory_->dictionary.bytes;
+    usage.postings = memory_->postings.bytes;
+    usage.forward_index = memory_->forward_index.bytes;
+    usage.document_store = memory_->document_store.bytes;
+    usage.stop_words = stop_words_memory_;
+    if (fuzzy_index_) {
+        usage.dictionary += fuzzy_index_->GetMemoryUsage();
+    }
+    return usage;
+}
+
+void SearchServer::SetMemoryBudget(size_t max_bytes) {
+    memory_budget_ = max_bytes;
+}
+
+size_t SearchServer::GetMemoryBudget() const {
+    return memory_budget_;
+}
+
+void SearchServer::SetMaxPrefixExpansion(size_t max_terms) {
+    max_prefix_expansion_ = max_terms;
+}
+
+size_t SearchServer::GetMaxPrefixExpansion() const {
+    return max_prefix_expansion_;
+}
+
+void SearchServer::SetFuzzyOptions(const FuzzyOptions& options) {
+    if (options.max_edits < 0 || options.max_edits > 2 || options.penalty < 0.0 || options.penalty > 1.0) {
+        throw std::invalid_argument("Invalid fuzzy search options"s);
+    }
+    fuzzy_options_ = options;
+    if (options.max_edits == 0) {
+        fuzzy_index_.reset();
+    }
+    else if (!fuzzy_index_ || fuzzy_index_->GetMaxEdits() != options.max_edits) {
+        fuzzy_index_ = std::make_unique<FuzzyTermIndex>(options.max_edits);
+        RebuildFuzzyIndex();
+    }
+}
+
+const SearchServer::FuzzyOptions& SearchServer::GetFuzzyOptions() const {
+    return fuzzy_options_;
+}
+
+size_t SearchServer::EstimateMemoryUsage(const PreparedDocument& document) {
+    const size_t per_document = StringHeapSize(document.text)
+        + sizeof(DocumentStore::value_type)
+        + TreeNodeSize<InternalIds::value_type>()
+        + TreeNodeSize<DocumentIds::value_type>()
+        + TreeNodeSize<ForwardIndex::value_type>();
+    // новое слово в худшем случае добавляет и узел словаря
+    const size_t per_word = TreeNodeSize<WordFrequencies::value_type>()
+        + TreeNodeSize<Postings::value_type>()
+        + TreeNodeSize<Dictionary::value_type>();
+    return per_document + per_word * document.words.size();
+}
+
+void SearchServer::CheckMemoryBudget(const PreparedDocument& document) const {
+    if (memory_budget_ == 0) {
+        return;
+    }
+    const size_t required = EstimateMemoryUsage(document);
+    if (GetMemoryUsage().GetTotal() + required > memory_budget_) {
+        throw std::length_error("Memory budget exceeded"s);
+    }
 }
 
 
@@ -146,9 +423,8 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     std::string_view raw_query,
     int document_id) const {
 
-    if ((document_id < 0) || (documents_.count(document_id) <= 0)) {
-        throw std::invalid_argument("Document ID doesn't exist"s);
-    }
+    const int internal_id = GetInternalId(document_id);
+    const DocumentStatus status = documents_[internal_id].status;
 
     const auto result = ParseQuery(raw_query);
     std::vector<std::string_view> matched_words;
@@ -157,8 +433,8 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         if (word_to_document_freqs_.count(word) == 0) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status };
+        if (word_to_document_freqs_.at(word).count(internal_id)) {
+            return { std::vector<std::string_view>{}, status };
         }
     }
 
@@ -166,35 +442,38 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         if (word_to_document_freqs_.count(word) == 0) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
+        if (word_to_document_freqs_.at(word).count(internal_id)) {
             matched_words.push_back(word);
         }
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    if (!MatchExpansions(result, internal_id, matched_words)) {
+        return { std::vector<std::string_view>{}, status };
+    }
+
+    return { matched_words, status };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&,
     std::string_view raw_query,
     int document_id) const {
 
-    if ((document_id < 0) || (documents_.count(document_id) <= 0)) {
-        throw std::invalid_argument("Document ID doesn't exist"s);
-    }
+    const int internal_id = GetInternalId(document_id);
+    const DocumentStatus status = documents_[internal_id].status;
 
     const auto& result = ParseQuery(raw_query);
 
-    const auto& check = [this, document_id](std::string_view word) {
+    const auto& check = [this, internal_id](std::string_view word) {
         const auto temp = word_to_document_freqs_.find(word);
         return temp != word_to_document_freqs_.end() &&
-            temp->second.count(document_id);
+            temp->second.count(internal_id);
     };
 
     if (std::any_of(std::execution::par,
         result.minus_words.begin(),
         result.minus_words.end(),
         check)) {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, status };
     }
 
     std::vector<std::string_view> matched_words(result.plus_words.size());
@@ -204,13 +483,49 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         result.plus_words.end(),
         matched_words.begin(),
         check);
+    matched_words.erase(end, matched_words.end());
+
+    if (!MatchExpansions(result, internal_id, matched_words)) {
+        return { std::vector<std::string_view>{}, status };
+    }
+    end = matched_words.end();
 
     std::sort(matched_words.begin(), end);
     end = std::unique(std::execution::par, matched_words.begin(),end);
 
     matched_words.erase(end, matched_words.end());
-    return { matched_words,
-            documents_.at(document_id).status };
+    return { matched_words, status };
+}
+
+bool SearchServer::MatchExpansions(const Query& query,
+    int internal_id,
+    std::vector<std::string_view>& matched_words) const {
+
+    bool excluded = false;
+    ExpandPrefixes(query.minus_prefixes, [&excluded, internal_id](std::string_view, const Postings& postings) {
+        excluded = excluded || postings.count(internal_id) > 0;
+    });
+    if (excluded) {
+        return false;
+    }
+    if (query.plus_prefixes.empty() && fuzzy_options_.max_edits <= 0) {
+        return true;
+    }
+
+    // раскрытые термины живут в словаре, в ответ отдаём слова из текста самого документа
+    const auto& document_words = docs_ids_to_word_freqs_.at(internal_id);
+    const auto add_matched = [&](std::string_view term, const Postings& postings) {
+        if (postings.count(internal_id)) {
+            matched_words.push_back(document_words.find(term)->first);
+        }
+    };
+    ExpandPrefixes(query.plus_prefixes, add_matched);
+    ExpandFuzzy(query.plus_words, [&add_matched](std::string_view term, const Postings& postings, int) {
+        add_matched(term, postings);
+    });
+    std::sort(matched_words.begin(), matched_words.end());
+    matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    return true;
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
@@ -263,7 +578,11 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view& text) con
     if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
         throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
-    return { text, is_minus, IsStopWord(text) };
+
+    if (text.size() > 1 && text.back() == '*') {
+        return { text.substr(0, text.size() - 1), is_minus, false, true };
+    }
+    return { text, is_minus, IsStopWord(text), false };
 }
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view& text) const {
@@ -271,7 +590,10 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view& text) const {
 
     for (std::string_view& word : SplitIntoWords(text)) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+        if (query_word.is_prefix) {
+            (query_word.is_minus ? result.minus_prefixes : result.plus_prefixes).push_back(query_word.data);
+        }
+        else if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 result.minus_words.push_back(query_word.data);
             }
@@ -291,9 +613,50 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view& text) const {
         result.plus_words.end()),
         result.plus_words.end());
 
+    for (auto* prefixes : { &result.plus_prefixes, &result.minus_prefixes }) {
+        std::sort(prefixes->begin(), prefixes->end());
+        prefixes->erase(std::unique(prefixes->begin(), prefixes->end()), prefixes->end());
+    }
+
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::RebuildFuzzyIndex() {
+    std::vector<std::string_view> terms;
+    terms.reserve(word_to_document_freqs_.size());
+    for (const auto& [term, _] : word_to_document_freqs_) {
+        terms.push_back(term);
+    }
+    fuzzy_index_->Build(terms);
+}
+
+std::vector<SearchServer::WeightedPostings> SearchServer::CollectPostings(const std::vector<std::string_view>& words,
+    const std::vector<std::string_view>& prefixes,
+    bool fuzzy) const {
+    std::vector<WeightedPostings> result;
+    for (const auto word : words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            result.push_back({ it->first, &it->second, 1.0 });
+        }
+    }
+
+    std::unordered_set<const Postings*> collected;
+    for (const auto& weighted : result) {
+        collected.insert(weighted.postings);
+    }
+    const auto add = [&result, &collected](std::string_view term, const Postings& postings, double weight) {
+        if (collected.insert(&postings).second) {
+            result.push_back({ term, &postings, weight });
+        }
+    };
+    ExpandPrefixes(prefixes, [&add](std::string_view term, const Postings& postings) {
+        add(term, postings, 1.0);
+    });
+    if (fuzzy) {
+        ExpandFuzzy(words, [this, &add](std::string_view term, const Postings& postings, int distance) {
+            add(term, postings, std::pow(fuzzy_options_.penalty, distance));
+        });
+    }
+    return result;
 }
\ No newline at end of file
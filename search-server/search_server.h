@@ -3,6 +3,7 @@
 #include <tuple>
 #include <algorithm>
 #include <cmath>
+#include <deque>
 #include <iostream>
 #include <map>
 #include <set>
@@ -12,59 +13,212 @@
 #include <vector>
 #include <random>
 #include <future>  
+#include <memory>
+#include <numeric>
+#include <thread>
 #include "concurrent_map.h"
+#include "memory_tracking.h"
+#include "fuzzy_term_index.h"
+#include "scoring.h"
+#include "term_dictionary.h"
 #include "read_input_functions.h"
 #include "string_processing.h"
 
 
 using namespace std::string_literals;
 
+// порядок внутренних номеров документов после SearchServer::ReorderDocuments
+enum class DocumentOrder {
+    INSERTION,
+    RATING,
+    CONTENT,
+};
+
+// политика выполнения FindTopDocuments: документы делятся на partitions диапазонов
+// внутренних номеров, каждый поток обходит все слова запроса в своём диапазоне.
+// В отличие от execution::par, параллельность не ограничена числом слов запроса
+// и потоки не делят общую карту релевантности
+struct PartitionedPolicy {
+    size_t partitions = std::max(1u, std::thread::hardware_concurrency());
+};
+
 class SearchServer {
 public:
+    using WordFrequencies = std::map<std::string_view, double, std::less<std::string_view>,
+        TrackingAllocator<std::pair<const std::string_view, double>>>;
+    using DocumentIds = std::set<int, std::less<int>, TrackingAllocator<int>>;
+
+    // потребление памяти по структурам индекса, в байтах
+    struct MemoryUsage {
+        size_t dictionary = 0;
+        size_t postings = 0;
+        size_t forward_index = 0;
+        size_t document_store = 0;
+        size_t stop_words = 0;
+
+        size_t GetTotal() const;
+    };
+
     template <typename StringContainer>
     SearchServer(const StringContainer& stop_words);
     SearchServer(const std::string& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
     SearchServer(std::string_view& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
     SearchServer() = default;
+    // копия заводит собственные счётчики памяти и индексирует документы заново
+    // (в порядке внутренних номеров), поэтому учёт памяти копии верен и ключи
+    // словаря ссылаются на её собственные тексты
+    SearchServer(const SearchServer& other);
+    SearchServer(SearchServer&& other) = default;
+
+    // документ, разобранный на слова без изменения индекса;
+    // PrepareDocument потокобезопасен, поэтому разбор можно вести параллельно.
+    // Слова хранятся смещениями в text: при перемещении короткой строки её буфер меняется
+    struct PreparedWord {
+        size_t offset;
+        size_t length;
+        double freq;
+    };
+
+    struct PreparedDocument {
+        int id = 0;
+        std::string text;
+        std::vector<PreparedWord> words;
+        int length = 0;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+    };
 
     void AddDocument(int document_id,
         std::string_view document,
         DocumentStatus status,
         const std::vector<int>& ratings);
+    void AddDocument(PreparedDocument&& document);
+    // проверки AddDocument без изменения индекса: std::invalid_argument для
+    // отрицательного или уже занятого id, std::length_error при выходе за бюджет памяти
+    void CheckDocument(const PreparedDocument& document) const;
 
+    PreparedDocument PrepareDocument(int document_id,
+        std::string_view document,
+        DocumentStatus status,
+        const std::vector<int>& ratings) const;
 
 
-    template <typename DocumentPredicate>
+
+    // ScoringPolicy задаёт формулу релевантности (см. scoring.h), по умолчанию TF-IDF
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
         DocumentPredicate document_predicate) const;
     
-    template <typename DocumentPredicate, typename ExecutionPolicy>
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy,
+        std::string_view raw_query,
+        DocumentPredicate document_predicate) const;
+
+    // веса слов считаются по статистике corpus, а не по этому индексу:
+    // так шард части коллекции ранжирует как единый индекс
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy,
         std::string_view raw_query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics& corpus) const;
+
+    // запрос, разобранный и раскрытый (префиксы, нечёткие совпадения) один раз:
+    // по нему можно оценить объём работы и затем выполнить поиск без повторного
+    // раскрытия. Ссылается на словарь индекса - действителен, пока индекс не меняется
+    class PreparedQuery;
+
+    PreparedQuery PrepareQuery(std::string_view raw_query) const;
+
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy,
+        const PreparedQuery& query,
         DocumentPredicate document_predicate) const;
 
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
         DocumentStatus status) const;
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&,
         std::string_view raw_query,
         DocumentStatus status) const;
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&,
         std::string_view raw_query,
         DocumentStatus status) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const PartitionedPolicy& policy,
+        std::string_view raw_query,
+        DocumentStatus status) const;
 
 
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&,
         std::string_view raw_query) const;
+    template <typename ScoringPolicy = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&,
         std::string_view raw_query) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const PartitionedPolicy& policy,
+        std::string_view raw_query) const;
 
     int GetDocumentCount() const;
+    bool HasDocument(int document_id) const;
+    IndexStatistics GetIndexStatistics() const;
+    // число документов, суммарная длина и документная частота слов запроса (с раскрытиями)
+    CorpusStatistics GetQueryStatistics(std::string_view raw_query) const;
+
+    static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    DocumentIds::const_iterator begin() const;
+    DocumentIds::const_iterator end() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+
+    // текст, средний рейтинг и статус документа, например для контрольной точки;
+    // для неизвестного id бросает std::out_of_range
+    struct StoredDocument {
+        std::string_view text;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+    };
+
+    StoredDocument GetStoredDocument(int document_id) const;
+
+    MemoryUsage GetMemoryUsage() const;
+    // 0 - без ограничения. Если оценка памяти под новый документ не помещается
+    // в бюджет, AddDocument бросает std::length_error, не меняя индекс
+    void SetMemoryBudget(size_t max_bytes);
+    size_t GetMemoryBudget() const;
+
+    // слово запроса вида "cat*" раскрывается в термины словаря с этим префиксом,
+    // не более max_terms первых по алфавиту на каждое такое слово
+    void SetMaxPrefixExpansion(size_t max_terms);
+    size_t GetMaxPrefixExpansion() const;
+
+    // нечёткий поиск: плюс-слово дополняется словами индекса на расстоянии
+    // Левенштейна до max_edits (слова короче 3 символов - без опечаток, короче 6 - не больше одной),
+    // не более max_terms ближайших; вклад такого слова умножается на penalty в степени расстояния
+    struct FuzzyOptions {
+        int max_edits = 0;
+        double penalty = 0.5;
+        size_t max_terms = 16;
+    };
+
+    void SetFuzzyOptions(const FuzzyOptions& options);
+    const FuzzyOptions& GetFuzzyOptions() const;
+
+    // Внутри индекса документы нумеруются подряд в порядке добавления, внешние id
+    // видны только снаружи. ReorderDocuments перенумеровывает документы и убирает
+    // пустые номера удалённых: INSERTION - прежний порядок, RATING - по убыванию
+    // рейтинга, CONTENT - документы с общими словами рядом. Списки документов слов
+    // обходятся в этом порядке. Перестраивает индекс без разбора текстов заново.
+    // RemoveDocument сам вызывает ReorderDocuments(INSERTION), когда пустых номеров
+    // становится больше, чем документов (и не меньше MIN_COMPACTION_HOLES)
+    void ReorderDocuments(DocumentOrder order);
+
+    static constexpr size_t MIN_COMPACTION_HOLES = 64;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
@@ -82,20 +236,51 @@ public:
 private:
     struct DocumentData {
         std::string data_string_;
+        int id;
         int rating;
         DocumentStatus status;
+        int length;
     };
 
-    const double EPSILON = 1e-6;
-    const int MAX_RESULT_DOCUMENT_COUNT = 5;
+    using Postings = std::map<int, double, std::less<int>,
+        TrackingAllocator<std::pair<const int, double>>>;
+    using Dictionary = std::map<std::string_view, Postings, std::less<std::string_view>,
+        TrackingAllocator<std::pair<const std::string_view, Postings>>>;
+    using ForwardIndex = std::map<int, WordFrequencies, std::less<int>,
+        TrackingAllocator<std::pair<const int, WordFrequencies>>>;
+    // по внутреннему номеру; deque не перемещает элементы при добавлении,
+    // поэтому ссылки индекса на data_string_ остаются верными
+    using DocumentStore = std::deque<DocumentData, TrackingAllocator<DocumentData>>;
+    using InternalIds = std::map<int, int, std::less<int>,
+        TrackingAllocator<std::pair<const int, int>>>;
+
+    struct MemoryCounters {
+        MemoryCounter dictionary;
+        MemoryCounter postings;
+        MemoryCounter forward_index;
+        MemoryCounter document_store;
+    };
 
     const std::set<std::string, std::less<>> stop_words_;
 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> docs_ids_to_word_freqs_;
+    // счётчики в куче, чтобы аллокаторы контейнеров переживали перемещение SearchServer
+    std::unique_ptr<MemoryCounters> memory_ = std::make_unique<MemoryCounters>();
+    size_t memory_budget_ = 0;
+    size_t stop_words_memory_ = 0;
+
+    uint64_t total_document_length_ = 0;
+    size_t max_prefix_expansion_ = 64;
+    FuzzyOptions fuzzy_options_;
+    // только при включённом нечётком поиске; меняется вместе со словарём
+    std::unique_ptr<FuzzyTermIndex> fuzzy_index_;
+
+    Dictionary word_to_document_freqs_{ Dictionary::allocator_type(&memory_->dictionary) };
+    ForwardIndex docs_ids_to_word_freqs_{ ForwardIndex::allocator_type(&memory_->forward_index) };
 
-    std::map<int, DocumentData> documents_;
-    std::set<int>document_ids_;
+    // списки документов слов и прямой индекс хранят внутренние номера
+    DocumentStore documents_{ DocumentStore::allocator_type(&memory_->document_store) };
+    InternalIds internal_ids_{ InternalIds::allocator_type(&memory_->document_store) };
+    DocumentIds document_ids_{ DocumentIds::allocator_type(&memory_->document_store) };
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
@@ -104,10 +289,20 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    static size_t EstimateMemoryUsage(const PreparedDocument& document);
+    void CheckMemoryBudget(const PreparedDocument& document) const;
+    void EraseDocument(int document_id);
+    // документ по внутреннему номеру в разобранном виде, с копией текста
+    PreparedDocument ExtractDocument(int internal_id) const;
+    // внутренний номер документа; для неизвестного id бросает std::out_of_range,
+    // как documents_.at до внутренней нумерации
+    int GetInternalId(int document_id) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
     };
 
     QueryWord ParseQueryWord(std::string_view& text) const;
@@ -115,23 +310,89 @@ private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<std::string_view> plus_prefixes;
+        std::vector<std::string_view> minus_prefixes;
     };
 
     Query ParseQuery(std::string_view& text) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view& word) const;
+    void RebuildFuzzyIndex();
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
+    // visitor(term, postings) для раскрытия каждого префикса, не более max_prefix_expansion_ терминов
+    template <typename Visitor>
+    void ExpandPrefixes(const std::vector<std::string_view>& prefixes, Visitor visitor) const;
+
+    // visitor(term, postings, distance) для близких к каждому слову терминов, кроме самого слова
+    template <typename Visitor>
+    void ExpandFuzzy(const std::vector<std::string_view>& words, Visitor visitor) const;
+
+    struct WeightedPostings {
+        std::string_view term;
+        const Postings* postings;
+        double weight;
+    };
+
+    // списки документов слов и их раскрытий без повторов: сначала слова,
+    // затем префиксы, затем нечёткие совпадения (если fuzzy)
+    std::vector<WeightedPostings> CollectPostings(const std::vector<std::string_view>& words,
+        const std::vector<std::string_view>& prefixes,
+        bool fuzzy) const;
+
+    // дополняет matched_words словами документа по префиксам и нечётким совпадениям;
+    // false, если документ содержит слово с минус-префиксом
+    bool MatchExpansions(const Query& query,
+        int internal_id,
+        std::vector<std::string_view>& matched_words) const;
+
+    // документная частота слова: из corpus, если она там есть, иначе по этому индексу
+    static size_t GetDocumentFreq(const WeightedPostings& weighted, const CorpusStatistics* corpus);
+
+    // лучшие MAX_RESULT_DOCUMENT_COUNT документов; веса слов по corpus, если он задан
+    template <typename ScoringPolicy, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> RankDocuments(ExecutionPolicy& policy,
+        const PreparedQuery& query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics* corpus) const;
+
+    template <typename ScoringPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const PreparedQuery& query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics* corpus) const;
+    template <typename ScoringPolicy, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&,
-        const Query& query,
-        DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
+        const PreparedQuery& query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics* corpus) const;
+    template <typename ScoringPolicy, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&,
-        const Query& query,
-        DocumentPredicate document_predicate) const;
+        const PreparedQuery& query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics* corpus) const;
+    template <typename ScoringPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const PartitionedPolicy& policy,
+        const PreparedQuery& query,
+        DocumentPredicate document_predicate,
+        const CorpusStatistics* corpus) const;
+
+    template <typename ExecutionPolicy>
+    static ExecutionPolicy& GetSortPolicy(ExecutionPolicy& policy) {
+        return policy;
+    }
+    static const std::execution::parallel_policy& GetSortPolicy(const PartitionedPolicy&) {
+        return std::execution::par;
+    }
+};
+
+class SearchServer::PreparedQuery {
+public:
+    // длины списков документов плюс-слов и их раскрытий
+    std::vector<size_t> GetPostingCounts() const;
+
+private:
+    friend class SearchServer;
+
+    std::vector<WeightedPostings> plus_postings_;
+    std::vector<WeightedPostings> minus_postings_;
 };
 
 template <typename StringContainer>
@@ -139,139 +400,353 @@ SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(Make
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
     }
+    for (const auto& word : stop_words_) {
+        stop_words_memory_ += TreeNodeSize<std::string>() + StringHeapSize(word);
+    }
 }
 
-template <typename DocumentPredicate>
+template <typename ScoringPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
     DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq,
+    return FindTopDocuments<ScoringPolicy>(std::execution::seq,
         raw_query,
         document_predicate);
 }
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
+template <typename ScoringPolicy, typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy,
     std::string_view raw_query,
     DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy,
+    return RankDocuments<ScoringPolicy>(policy,
+        PrepareQuery(raw_query),
+        document_predicate,
+        nullptr);
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy,
+    std::string_view raw_query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics& corpus) const {
+    return RankDocuments<ScoringPolicy>(policy,
+        PrepareQuery(raw_query),
+        document_predicate,
+        &corpus);
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy,
+    const PreparedQuery& query,
+    DocumentPredicate document_predicate) const {
+    return RankDocuments<ScoringPolicy>(policy,
         query,
-        document_predicate);
+        document_predicate,
+        nullptr);
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::RankDocuments(ExecutionPolicy& policy,
+    const PreparedQuery& query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics* corpus) const {
+    auto matched_documents = FindAllDocuments<ScoringPolicy>(policy,
+        query,
+        document_predicate,
+        corpus);
 
-    sort(policy,
+    // нужны только первые MAX_RESULT_DOCUMENT_COUNT
+    const size_t count = std::min(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(GetSortPolicy(policy),
         matched_documents.begin(),
+        matched_documents.begin() + count,
         matched_documents.end(),
-        [this](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+        ScoringPolicy::IsMoreRelevant);
+    matched_documents.resize(count);
     return matched_documents;
 }
 
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::seq, raw_query, status);
+}
 
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&,
+    std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::seq,
+        raw_query,
+        [status](int document_id,
+            DocumentStatus document_status,
+            int rating) {
+                return document_status == status;
+        }
+    );
+}
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
-    DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq,
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&,
+    std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::par,
+        raw_query,
+        [status](int document_id,
+            DocumentStatus document_status,
+            int rating) {
+                return document_status == status;
+        }
+    );
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const PartitionedPolicy& policy,
+    std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(policy,
+        raw_query,
+        [status](int document_id,
+            DocumentStatus document_status,
+            int rating) {
+                return document_status == status;
+        }
+    );
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::seq,
+        raw_query,
+        DocumentStatus::ACTUAL);
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&,
+    std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::seq,
+        raw_query,
+        DocumentStatus::ACTUAL);
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&,
+    std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(std::execution::par,
+        raw_query,
+        DocumentStatus::ACTUAL);
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const PartitionedPolicy& policy,
+    std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(policy,
+        raw_query,
+        DocumentStatus::ACTUAL);
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const PreparedQuery& query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics* corpus) const {
+    return FindAllDocuments<ScoringPolicy>(std::execution::seq,
         query,
-        document_predicate);
+        document_predicate,
+        corpus);
 }
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&,
-    const Query& query,
-    DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
 
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+template <typename Visitor>
+void SearchServer::ExpandPrefixes(const std::vector<std::string_view>& prefixes, Visitor visitor) const {
+    if (prefixes.empty()) {
+        return;
+    }
+    // словарь уже отсортирован: термины с префиксом идут подряд от lower_bound
+    for (const auto prefix : prefixes) {
+        size_t expanded = 0;
+        for (auto it = word_to_document_freqs_.lower_bound(prefix);
+            it != word_to_document_freqs_.end() && expanded < max_prefix_expansion_ && it->first.substr(0, prefix.size()) == prefix;
+            ++it, ++expanded) {
+            visitor(it->first, it->second);
+        }
+    }
+}
+
+template <typename Visitor>
+void SearchServer::ExpandFuzzy(const std::vector<std::string_view>& words, Visitor visitor) const {
+    if (!fuzzy_index_ || words.empty()) {
+        return;
+    }
+    for (const auto word : words) {
+        const int max_edits = std::min(fuzzy_options_.max_edits, word.size() < 3 ? 0 : word.size() < 6 ? 1 : 2);
+        if (max_edits == 0) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id,
+
+        size_t expanded = 0;
+        for (const auto& match : fuzzy_index_->FindMatches(word, max_edits)) {
+            if (expanded == fuzzy_options_.max_terms) {
+                break;
+            }
+            // удалённый термин остаётся в индексе до его перестройки
+            const auto entry = word_to_document_freqs_.find(match.term);
+            if (match.distance == 0 || entry == word_to_document_freqs_.end()) {
+                continue;
+            }
+            ++expanded;
+            visitor(entry->first, entry->second, match.distance);
+        }
+    }
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&,
+    const PreparedQuery& query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics* corpus) const {
+    std::map<int, double> document_to_relevance;
+    const auto index = corpus ? corpus->GetIndexStatistics() : GetIndexStatistics();
+
+    for (const auto& weighted : query.plus_postings_) {
+        const double term_weight = ScoringPolicy::ComputeTermWeight(index, GetDocumentFreq(weighted, corpus)) * weighted.weight;
+        for (const auto [internal_id, term_freq] : *weighted.postings) {
+            const auto& document_data = documents_[internal_id];
+            if (document_predicate(document_data.id,
                 document_data.status,
                 document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                document_to_relevance[internal_id] += ScoringPolicy::ComputeScore(term_weight,
+                    term_freq, index, document_data.length, document_data.rating);
             }
         }
     }
 
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+    for (const auto& weighted : query.minus_postings_) {
+        for (const auto [internal_id, _] : *weighted.postings) {
+            document_to_relevance.erase(internal_id);
         }
     }
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id,
+    for (const auto [internal_id, relevance] : document_to_relevance) {
+        const auto& document_data = documents_[internal_id];
+        matched_documents.push_back({ document_data.id,
                                      relevance,
-                                     documents_.at(document_id).rating });
+                                     document_data.rating });
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
+template <typename ScoringPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&,
-    const Query& query,
-    DocumentPredicate document_predicate) const {
+    const PreparedQuery& query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics* corpus) const {
     static const int bucket_count = 50;
     ConcurrentMap<int, double> document_to_relevance(bucket_count);
+    const auto index = corpus ? corpus->GetIndexStatistics() : GetIndexStatistics();
 
     const auto plus_func = [this,
+        &index,
+        corpus,
         &document_predicate,
-        &document_to_relevance] (std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id,
+        &document_to_relevance] (const WeightedPostings& weighted) {
+        const double term_weight = ScoringPolicy::ComputeTermWeight(index, GetDocumentFreq(weighted, corpus)) * weighted.weight;
+        for (const auto& [internal_id, term_freq] : *weighted.postings) {
+            const auto& document_data = documents_[internal_id];
+            if (document_predicate(document_data.id,
                 document_data.status,
                 document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                document_to_relevance[internal_id].ref_to_value += ScoringPolicy::ComputeScore(term_weight,
+                    term_freq, index, document_data.length, document_data.rating);
             }
         }
     };
 
+    const auto& plus_postings = query.plus_postings_;
     for_each(std::execution::par,
-        query.plus_words.begin(),
-        query.plus_words.end(),
+        plus_postings.begin(),
+        plus_postings.end(),
         plus_func);
 
-    const auto minus_words_erase = [&](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
-        }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+    const auto minus_words_erase = [&](const WeightedPostings& weighted) {
+        for (const auto& [internal_id, _] : *weighted.postings) {
+            document_to_relevance.erase(internal_id);
         }
     };
 
+    const auto& minus_postings = query.minus_postings_;
     for_each(std::execution::par,
-        query.minus_words.begin(),
-        query.minus_words.end(),
+        minus_postings.begin(),
+        minus_postings.end(),
         minus_words_erase);
 
     const auto& doc_to_rel = document_to_relevance.BuildOrdinaryMap();
 
     std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : doc_to_rel) {
-        matched_documents.push_back({ document_id,
+    for (const auto& [internal_id, relevance] : doc_to_rel) {
+        const auto& document_data = documents_[internal_id];
+        matched_documents.push_back({ document_data.id,
                                      relevance,
-                                     documents_.at(document_id).rating });
+                                     document_data.rating });
+    }
+    return matched_documents;
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const PartitionedPolicy& policy,
+    const PreparedQuery& query,
+    DocumentPredicate document_predicate,
+    const CorpusStatistics* corpus) const {
+    const auto index = corpus ? corpus->GetIndexStatistics() : GetIndexStatistics();
+    const auto& plus_postings = query.plus_postings_;
+    const auto& minus_postings = query.minus_postings_;
+
+    std::vector<double> term_weights;
+    term_weights.reserve(plus_postings.size());
+    for (const auto& weighted : plus_postings) {
+        term_weights.push_back(ScoringPolicy::ComputeTermWeight(index, GetDocumentFreq(weighted, corpus)) * weighted.weight);
+    }
+
+    // диапазоны не пересекаются, поэтому их результаты просто склеиваются
+    // в порядке внутренних номеров, как в последовательной версии
+    const size_t document_limit = documents_.size();
+    const size_t partition_count = std::max<size_t>(1, std::min(policy.partitions, document_limit));
+    std::vector<std::vector<Document>> partition_documents(partition_count);
+    std::vector<size_t> partitions(partition_count);
+    std::iota(partitions.begin(), partitions.end(), 0);
+
+    std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](size_t partition) {
+        const int first = static_cast<int>(partition * document_limit / partition_count);
+        const int last = static_cast<int>((partition + 1) * document_limit / partition_count);
+        std::map<int, double> document_to_relevance;
+
+        for (size_t i = 0; i < plus_postings.size(); ++i) {
+            const auto& postings = *plus_postings[i].postings;
+            for (auto it = postings.lower_bound(first); it != postings.end() && it->first < last; ++it) {
+                const auto& document_data = documents_[it->first];
+                if (document_predicate(document_data.id,
+                    document_data.status,
+                    document_data.rating)) {
+                    document_to_relevance[it->first] += ScoringPolicy::ComputeScore(term_weights[i],
+                        it->second, index, document_data.length, document_data.rating);
+                }
+            }
+        }
+        for (const auto& weighted : minus_postings) {
+            for (auto it = weighted.postings->lower_bound(first); it != weighted.postings->end() && it->first < last; ++it) {
+                document_to_relevance.erase(it->first);
+            }
+        }
+
+        auto& matched_documents = partition_documents[partition];
+        for (const auto [internal_id, relevance] : document_to_relevance) {
+            const auto& document_data = documents_[internal_id];
+            matched_documents.push_back({ document_data.id,
+                                         relevance,
+                                         document_data.rating });
+        }
+    });
+
+    std::vector<Document> matched_documents;
+    for (const auto& documents : partition_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
     }
     return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,264 @@
+#include "sharded_search_server.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <mutex>
+
+namespace {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> ParseCpuList(std::string_view text) {
+    std::vector<int> cpus;
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        auto range = text.substr(0, comma);
+        text.remove_prefix(comma == text.npos ? text.size() : comma + 1);
+        while (!range.empty() && (range.back() == '\n' || range.back() == ' ')) {
+            range.remove_suffix(1);
+        }
+        if (range.empty()) {
+            continue;
+        }
+        const auto dash = range.find('-');
+        const int first = ParseInt(range.substr(0, dash));
+        const int last = dash == range.npos ? first : ParseInt(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// процессоры, доступные процессу, по очереди из каждого узла NUMA:
+// соседние шарды попадают на разные узлы. Без сведений о NUMA - просто по порядку
+std::vector<int> ListShardCpus() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream cpulist("/sys/devices/system/node/node"s + std::to_string(node) + "/cpulist"s);
+        if (!cpulist) {
+            break;
+        }
+        std::string text;
+        std::getline(cpulist, text);
+        std::vector<int> cpus;
+        try {
+            for (const int cpu : ParseCpuList(text)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        catch (const std::invalid_argument&) {
+            continue;
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+    if (nodes.empty()) {
+        nodes.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                nodes.back().push_back(cpu);
+            }
+        }
+    }
+
+    std::vector<int> result;
+    for (size_t i = 0, added = 1; added > 0; ++i) {
+        added = 0;
+        for (const auto& cpus : nodes) {
+            if (i < cpus.size()) {
+                result.push_back(cpus[i]);
+                ++added;
+            }
+        }
+    }
+    return result;
+}
+
+void PinThread(std::thread& thread, int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    // закрепление - только оптимизация, ошибку игнорируем
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+}  // namespace
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count)
+    : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count) {
+}
+
+ShardedSearchServer::~ShardedSearchServer() {
+    for (auto& shard : shards_) {
+        shard->tasks.Close();
+    }
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+}
+
+void ShardedSearchServer::StartWorkers() {
+    const auto cpus = ListShardCpus();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = *shards_[i];
+        shard.thread = std::thread([&shard] {
+            while (auto task = shard.tasks.Pop()) {
+                (*task)();
+            }
+        });
+        if (!cpus.empty()) {
+            PinThread(shard.thread, cpus[i % cpus.size()]);
+        }
+    }
+}
+
+void ShardedSearchServer::ForEachShard(const std::function<void(size_t, SearchServer&)>& task) const {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = shards_.size();
+    std::exception_ptr error;
+
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        SearchServer* server = &shards_[i]->server;
+        shards_[i]->tasks.Push([&, i, server] {
+            std::exception_ptr shard_error;
+            try {
+                task(i, *server);
+            }
+            catch (...) {
+                shard_error = std::current_exception();
+            }
+            // уведомляем под мьютексом: после выхода из ожидания они уничтожаются
+            std::lock_guard lock(mutex);
+            if (shard_error && !error) {
+                error = shard_error;
+            }
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&remaining] { return remaining == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ShardedSearchServer::RunOnShard(size_t index, const std::function<void(SearchServer&)>& task) const {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool finished = false;
+    std::exception_ptr error;
+
+    shards_.at(index)->tasks.Push([&, index] {
+        std::exception_ptr shard_error;
+        try {
+            task(shards_[index]->server);
+        }
+        catch (...) {
+            shard_error = std::current_exception();
+        }
+        std::lock_guard lock(mutex);
+        error = shard_error;
+        finished = true;
+        done.notify_one();
+    });
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&finished] { return finished; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id,
+    std::string_view document,
+    DocumentStatus status,
+    const std::vector<int>& ratings) {
+    RunOnShard(GetShardIndex(document_id), [&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    RunOnShard(GetShardIndex(document_id), [document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ShardedSearchServer::SetMaxPrefixExpansion(size_t max_terms) {
+    ForEachShard([max_terms](size_t, SearchServer& server) {
+        server.SetMaxPrefixExpansion(max_terms);
+    });
+}
+
+void ShardedSearchServer::SetFuzzyOptions(const SearchServer::FuzzyOptions& options) {
+    ForEachShard([&options](size_t, SearchServer& server) {
+        server.SetFuzzyOptions(options);
+    });
+}
+
+void ShardedSearchServer::ReorderDocuments(DocumentOrder order) {
+    ForEachShard([order](size_t, SearchServer& server) {
+        server.ReorderDocuments(order);
+    });
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query,
+    int document_id) const {
+    std::tuple<std::vector<std::string_view>, DocumentStatus> result;
+    RunOnShard(GetShardIndex(document_id), [&](SearchServer& server) {
+        result = server.MatchDocument(raw_query, document_id);
+    });
+    return result;
+}
+
+CorpusStatistics ShardedSearchServer::CollectStatistics(std::string_view raw_query) const {
+    std::vector<CorpusStatistics> shard_statistics(shards_.size());
+    ForEachShard([&](size_t index, SearchServer& server) {
+        shard_statistics[index] = server.GetQueryStatistics(raw_query);
+    });
+
+    CorpusStatistics result;
+    for (const auto& statistics : shard_statistics) {
+        result.Merge(statistics);
+    }
+    return result;
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int count = 0;
+    for (const auto& shard : shards_) {
+        count += shard->server.GetDocumentCount();
+    }
+    return count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return static_cast<unsigned>(document_id) % shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index)->server;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "search_server.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Индекс, разбитый по id документа на shard_count частей внутри процесса.
+// У каждого шарда свой SearchServer и свой поток, закреплённый за процессором
+// (процессоры выбираются по очереди из узлов NUMA); все обращения к шарду
+// выполняются этим потоком, поэтому память индекса выделяется на его узле.
+// Запрос рассылается всем шардам в два шага: сбор статистики слов
+// для общего IDF, затем поиск лучших документов в каждом шарде и их слияние.
+// Префиксные и нечёткие раскрытия ограничиваются в каждом шарде отдельно.
+//
+// Как и SearchServer: константные методы можно вызывать из разных потоков
+// одновременно, изменения не должны пересекаться с другими вызовами.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+    ~ShardedSearchServer();
+
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void AddDocument(int document_id,
+        std::string_view document,
+        DocumentStatus status,
+        const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    void SetMaxPrefixExpansion(size_t max_terms);
+    void SetFuzzyOptions(const SearchServer::FuzzyOptions& options);
+    // SearchServer::ReorderDocuments во всех шардах параллельно
+    void ReorderDocuments(DocumentOrder order);
+
+    // предикат вызывается из потоков шардов одновременно
+    template <typename ScoringPolicy = TfIdfScoring, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        DocumentPredicate document_predicate) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        DocumentStatus status) const;
+    template <typename ScoringPolicy = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
+        int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+    size_t GetShardIndex(int document_id) const;
+    const SearchServer& GetShard(size_t index) const;
+
+private:
+    struct Shard {
+        explicit Shard(SearchServer server) : server(std::move(server)) {}
+
+        SearchServer server;
+        BoundedQueue<std::function<void()>> tasks{ task_queue_capacity_ };
+        std::thread thread;
+    };
+
+    static const size_t task_queue_capacity_ = 64;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    void StartWorkers();
+
+    // выполняет task(index, server) в потоках всех шардов и ждёт завершения;
+    // первое исключение из шардов пробрасывается вызывающему
+    void ForEachShard(const std::function<void(size_t, SearchServer&)>& task) const;
+    void RunOnShard(size_t index, const std::function<void(SearchServer&)>& task) const;
+
+    CorpusStatistics CollectStatistics(std::string_view raw_query) const;
+
+    template <typename Comparator>
+    static std::vector<Document> MergeTopDocuments(std::vector<std::vector<Document>>& shard_results,
+        Comparator comparator);
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>(SearchServer(stop_words)));
+    }
+    StartWorkers();
+}
+
+template <typename ScoringPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+    DocumentPredicate document_predicate) const {
+    if (shards_.size() == 1) {
+        std::vector<Document> result;
+        RunOnShard(0, [&](SearchServer& server) {
+            result = server.FindTopDocuments<ScoringPolicy>(std::execution::seq, raw_query, document_predicate);
+        });
+        return result;
+    }
+
+    const CorpusStatistics corpus = CollectStatistics(raw_query);
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    ForEachShard([&](size_t index, SearchServer& server) {
+        shard_results[index] = server.FindTopDocuments<ScoringPolicy>(std::execution::seq,
+            raw_query,
+            document_predicate,
+            corpus);
+    });
+    return MergeTopDocuments(shard_results, ScoringPolicy::IsMoreRelevant);
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+    DocumentStatus status) const {
+    return FindTopDocuments<ScoringPolicy>(raw_query,
+        [status](int document_id,
+            DocumentStatus document_status,
+            int rating) {
+                return document_status == status;
+        }
+    );
+}
+
+template <typename ScoringPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<ScoringPolicy>(raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Comparator>
+std::vector<Document> ShardedSearchServer::MergeTopDocuments(std::vector<std::vector<Document>>& shard_results,
+    Comparator comparator) {
+    std::vector<Document> result;
+    for (auto& documents : shard_results) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+    // лучшие документы коллекции входят в лучшие своего шарда
+    const size_t count = std::min(result.size(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(result.begin(), result.begin() + count, result.end(), comparator);
+    result.resize(count);
+    return result;
+}
@@ -1,5 +1,10 @@
 #include "string_processing.h"
 
+#include <charconv>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> words;
     std::string_view space_delimiter = " ";
@@ -16,4 +21,39 @@ std::vector<std::string_view> SplitIntoWords(std::string_view text) {
         start_pos = text.find_first_not_of(space_delimiter, space);
     }
     return words;
-}
\ No newline at end of file
+}
+
+std::string_view NextToken(std::string_view& text) {
+    const auto start = text.find_first_not_of(' ');
+    if (start == text.npos) {
+        text = {};
+        return {};
+    }
+    text.remove_prefix(start);
+    const auto end = text.find(' ');
+    const auto token = text.substr(0, end);
+    text.remove_prefix(end == text.npos ? text.size() : end);
+    return token;
+}
+
+int ParseInt(std::string_view text) {
+    int value = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number "s + std::string(text));
+    }
+    return value;
+}
+
+std::vector<int> ParseRatings(std::string_view text) {
+    std::vector<int> ratings;
+    if (text == "-") {
+        return ratings;
+    }
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        ratings.push_back(ParseInt(text.substr(0, comma)));
+        text.remove_prefix(comma == text.npos ? text.size() : comma + 1);
+    }
+    return ratings;
+}
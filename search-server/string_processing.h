@@ -6,6 +6,12 @@
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+// отрезает от text очередное слово, разделённое пробелами
+std::string_view NextToken(std::string_view& text);
+int ParseInt(std::string_view text);
+// "1,2,3" или "-" для пустого списка
+std::vector<int> ParseRatings(std::string_view text);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::string_literals;
+
+// Отсортированный словарь с префиксным сжатием (front coding).
+// Термины хранятся блоками по block_size_: первый целиком, остальные как
+// длина общего с предыдущим префикса и суффикс. Поиск - двоичный по первым
+// терминам блоков, затем последовательная распаковка одного блока.
+template <typename Value>
+class TermDictionary {
+public:
+    // термины добавляются строго по возрастанию
+    void Add(std::string_view term, Value value) {
+        if (!values_.empty() && term <= last_term_) {
+            throw std::invalid_argument("Terms must be added in ascending order"s);
+        }
+        size_t shared = 0;
+        if (values_.size() % block_size_ == 0) {
+            block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        }
+        else {
+            const size_t limit = std::min(term.size(), last_term_.size());
+            while (shared < limit && term[shared] == last_term_[shared]) {
+                ++shared;
+            }
+        }
+        WriteVarint(shared);
+        WriteVarint(term.size() - shared);
+        data_.append(term.substr(shared));
+
+        last_term_.assign(term);
+        values_.push_back(std::move(value));
+    }
+
+    size_t size() const {
+        return values_.size();
+    }
+
+    // номер термина term или size(), если его нет
+    size_t Find(std::string_view term) const {
+        if (values_.empty()) {
+            return values_.size();
+        }
+        size_t index = FindBlock(term) * block_size_;
+        size_t offset = block_offsets_[index / block_size_];
+        const size_t last = std::min(index + block_size_, values_.size());
+        std::string buffer;
+        for (; index < last; ++index) {
+            const std::string_view current = DecodeNext(offset, buffer);
+            if (current == term) {
+                return index;
+            }
+            if (current > term) {
+                break;
+            }
+        }
+        return values_.size();
+    }
+
+    // термин по номеру: распаковка от начала его блока, buffer хранит результат
+    std::string_view GetTerm(size_t index, std::string& buffer) const {
+        size_t offset = block_offsets_[index / block_size_];
+        buffer.clear();
+        for (size_t i = index - index % block_size_; i < index; ++i) {
+            DecodeNext(offset, buffer);
+        }
+        return DecodeNext(offset, buffer);
+    }
+
+    const Value& GetValue(size_t index) const {
+        return values_[index];
+    }
+
+    size_t GetMemoryUsage() const {
+        return data_.capacity() + block_offsets_.capacity() * sizeof(uint32_t)
+            + values_.capacity() * sizeof(Value);
+    }
+
+private:
+    static const size_t block_size_ = 16;
+
+    std::string data_;
+    std::vector<uint32_t> block_offsets_;
+    std::vector<Value> values_;
+    std::string last_term_;
+
+    void WriteVarint(size_t value) {
+        while (value >= 0x80) {
+            data_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data_.push_back(static_cast<char>(value));
+    }
+
+    size_t ReadVarint(size_t& offset) const {
+        size_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const auto byte = static_cast<unsigned char>(data_[offset++]);
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    // первый термин блока записан целиком, его можно сравнивать без распаковки
+    std::string_view BlockFirstTerm(size_t block) const {
+        size_t offset = block_offsets_[block];
+        ReadVarint(offset);
+        const size_t length = ReadVarint(offset);
+        return std::string_view(data_).substr(offset, length);
+    }
+
+    // следующий термин блока; buffer - предыдущий термин того же блока
+    std::string_view DecodeNext(size_t& offset, std::string& buffer) const {
+        const size_t shared = ReadVarint(offset);
+        const size_t suffix = ReadVarint(offset);
+        buffer.resize(shared);
+        buffer.append(data_, offset, suffix);
+        offset += suffix;
+        return buffer;
+    }
+
+    // последний блок, первый термин которого <= term
+    size_t FindBlock(std::string_view term) const {
+        size_t left = 0;
+        size_t right = block_offsets_.size();
+        while (right - left > 1) {
+            const size_t middle = (left + right) / 2;
+            if (BlockFirstTerm(middle) <= term) {
+                left = middle;
+            }
+            else {
+                right = middle;
+            }
+        }
+        return left;
+    }
+};
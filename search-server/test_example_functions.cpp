@@ -0,0 +1,1125 @@
+#include "test_example_functions.h"
+#include "fuzzy_term_index.h"
+#include "query_planner.h"
+#include "query_server.h"
+#include "request_queue.h"
+#include "search_broker.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+#include "write_ahead_log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file,
+    const std::string& func, unsigned line, const std::string& hint) {
+    if (!value) {
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+namespace {
+
+std::string GenerateWord(std::mt19937& generator) {
+    std::string word(std::uniform_int_distribution(2, 7)(generator), ' ');
+    for (char& c : word) {
+        c = static_cast<char>(std::uniform_int_distribution<int>('a', 'h')(generator));
+    }
+    return word;
+}
+
+std::string GenerateText(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count) {
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        text += dictionary[std::uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+    }
+    return text;
+}
+
+// порядок выдачи полный (RelevanceOrder), поэтому документы совпадают по позициям
+void AssertSameDocuments(const std::vector<Document>& expected, const std::vector<Document>& actual, const std::string& query) {
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, query);
+        ASSERT_HINT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-9, query);
+        ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, query);
+    }
+}
+
+// документы с текстом, рейтингом, статусом и частотами слов - для сравнения индексов
+std::string DumpIndex(const SearchServer& search_server) {
+    std::string dump;
+    for (const int document_id : search_server) {
+        const auto document = search_server.GetStoredDocument(document_id);
+        dump += std::to_string(document_id) + " "s + std::to_string(document.rating) + " "s
+            + std::string(DocumentStatusToString(document.status)) + " "s + std::string(document.text) + "\n"s;
+        for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
+            dump += std::string(word) + ":"s + std::to_string(freq) + " "s;
+        }
+        dump += "\n"s;
+    }
+    return dump;
+}
+
+// каталог для файлов журнала, удаляется вместе с ними
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        std::string path = "/tmp/search-server-test-XXXXXX"s;
+        if (mkdtemp(path.data()) == nullptr) {
+            throw std::runtime_error("Can't create temporary directory"s);
+        }
+        path_ = path;
+    }
+
+    ~TemporaryDirectory() {
+        for (const auto& name : names_) {
+            std::remove(name.c_str());
+        }
+        rmdir(path_.c_str());
+    }
+
+    std::string GetPath(const std::string& name) {
+        names_.push_back(path_ + "/"s + name);
+        return names_.back();
+    }
+
+private:
+    std::string path_;
+    std::vector<std::string> names_;
+};
+
+void CopyFile(const std::string& from, const std::string& to) {
+    std::ifstream input(from, std::ios::binary);
+    std::ofstream output(to, std::ios::binary | std::ios::trunc);
+    output << input.rdbuf();
+}
+
+long GetFileSize(const std::string& path) {
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    return static_cast<long>(input.tellg());
+}
+
+// изменения записываются в журнал до применения, как в QueryServer
+void AddLoggedDocuments(SearchServer& search_server, WriteAheadLog& log, int first_id, int last_id) {
+    for (int id = first_id; id < last_id; ++id) {
+        const std::string text = "doc"s + std::to_string(id % 13) + " word"s + std::to_string(id % 7) + " common"s;
+        const DocumentStatus status = id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        const std::vector<int> ratings = { id % 9, -(id % 4) };
+        log.LogAddDocument(id, text, status, ratings);
+        search_server.AddDocument(id, text, status, ratings);
+    }
+}
+
+void RemoveLoggedDocument(SearchServer& search_server, WriteAheadLog& log, int document_id) {
+    log.LogRemoveDocument(document_id);
+    search_server.RemoveDocument(document_id);
+}
+
+// шарды распределённого поиска на loopback: QueryServer с собственным индексом
+class LocalShards {
+public:
+    explicit LocalShards(size_t shard_count) {
+        for (size_t i = 0; i < shard_count; ++i) {
+            auto shard = std::make_unique<Shard>();
+            shard->query_server = std::make_unique<QueryServer>(shard->search_server, 0, 1);
+            shard->port = shard->query_server->GetPort();
+            shard->thread = std::thread([&query_server = *shard->query_server] {
+                query_server.Run();
+            });
+            shards_.push_back(std::move(shard));
+        }
+    }
+
+    ~LocalShards() {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            Stop(i);
+        }
+    }
+
+    std::vector<ShardAddress> GetAddresses() const {
+        std::vector<ShardAddress> addresses;
+        for (const auto& shard : shards_) {
+            addresses.push_back({ "127.0.0.1"s, shard->port });
+        }
+        return addresses;
+    }
+
+    // останавливает шард и закрывает его соединения
+    void Stop(size_t index) {
+        Shard& shard = *shards_[index];
+        if (!shard.query_server) {
+            return;
+        }
+        shard.query_server->Stop();
+        shard.thread.join();
+        shard.query_server.reset();
+    }
+
+private:
+    struct Shard {
+        SearchServer search_server{ "and in"s };
+        std::unique_ptr<QueryServer> query_server;
+        std::thread thread;
+        uint16_t port = 0;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// принимает соединения (очередь listen), но никогда не отвечает
+class SilentShard {
+public:
+    SilentShard() {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (fd_ < 0 || bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(fd_, 16) != 0 || getsockname(fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            throw std::runtime_error("Can't open silent shard socket"s);
+        }
+        port_ = ntohs(address.sin_port);
+    }
+
+    ~SilentShard() {
+        close(fd_);
+    }
+
+    ShardAddress GetAddress() const {
+        return { "127.0.0.1"s, port_ };
+    }
+
+private:
+    int fd_ = -1;
+    uint16_t port_ = 0;
+};
+
+// блокирующий клиент QueryServer на loopback
+class LineClient {
+public:
+    explicit LineClient(uint16_t port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            throw std::runtime_error("Can't connect to query server"s);
+        }
+    }
+
+    ~LineClient() {
+        close(fd_);
+    }
+
+    void Send(const std::string& text) {
+        ASSERT(send(fd_, text.data(), text.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(text.size()));
+    }
+
+    std::string ReadLine() {
+        while (buffer_.find('\n') == buffer_.npos) {
+            char chunk[4096];
+            const ssize_t readed = recv(fd_, chunk, sizeof(chunk), 0);
+            ASSERT(readed > 0);
+            buffer_.append(chunk, readed);
+        }
+        const auto newline = buffer_.find('\n');
+        std::string line = buffer_.substr(0, newline);
+        buffer_.erase(0, newline + 1);
+        return line;
+    }
+
+private:
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+}  // namespace
+
+void TestShardedSearchMatchesSingleServer() {
+    std::mt19937 generator(42);
+    std::vector<std::string> dictionary;
+    for (int i = 0; i < 400; ++i) {
+        dictionary.push_back(GenerateWord(generator));
+    }
+
+    const std::string stop_words = dictionary[0] + " "s + dictionary[1];
+    SearchServer single(stop_words);
+    ShardedSearchServer sharded(stop_words, 3);
+    // ограничения раскрытий действуют в каждом шарде отдельно, здесь они не достигаются
+    const size_t max_terms = 1000;
+    single.SetMaxPrefixExpansion(max_terms);
+    sharded.SetMaxPrefixExpansion(max_terms);
+    single.SetFuzzyOptions({ 2, 0.5, max_terms });
+    sharded.SetFuzzyOptions({ 2, 0.5, max_terms });
+
+    // id с пропусками, чтобы документы расходились по всем шардам
+    const auto document_id = [](int index) {
+        return index * 2 + 1;
+    };
+    const DocumentStatus statuses[] = { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED };
+    for (int index = 0; index < 600; ++index) {
+        const std::string text = GenerateText(generator, dictionary, std::uniform_int_distribution(3, 30)(generator));
+        const std::vector<int> ratings = { index % 11 - 5, index % 7 };
+        const DocumentStatus status = statuses[index % 10 == 0 ? 2 : index % 7 == 0 ? 1 : 0];
+        single.AddDocument(document_id(index), text, status, ratings);
+        sharded.AddDocument(document_id(index), text, status, ratings);
+    }
+    for (int index = 0; index < 600; index += 9) {
+        single.RemoveDocument(document_id(index));
+        sharded.RemoveDocument(document_id(index));
+    }
+    ASSERT_EQUAL(sharded.GetDocumentCount(), single.GetDocumentCount());
+    for (size_t shard = 0; shard < sharded.GetShardCount(); ++shard) {
+        ASSERT(sharded.GetShard(shard).GetDocumentCount() > 0);
+    }
+
+    for (int i = 0; i < 300; ++i) {
+        std::string query;
+        for (int j = 0; j < 3; ++j) {
+            std::string word = dictionary[std::uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+            if (j == 0 && i % 3 == 1) {
+                word = word.substr(0, 2) + "*"s;
+            }
+            else if (j == 2 && i % 4 == 2) {
+                word = "-"s + word;
+            }
+            else if (i % 5 == 3) {
+                word[0] = 'a';
+            }
+            query += word + " "s;
+        }
+
+        AssertSameDocuments(single.FindTopDocuments(query), sharded.FindTopDocuments(query), query);
+        AssertSameDocuments(single.FindTopDocuments<Bm25Scoring>(query, DocumentStatus::BANNED),
+            sharded.FindTopDocuments<Bm25Scoring>(query, DocumentStatus::BANNED), query);
+        // меньше MAX_RESULT_DOCUMENT_COUNT совпадений - сравниваются все найденные документы
+        const auto predicate = [i](int document_id, DocumentStatus, int) {
+            return document_id % 151 == i % 151;
+        };
+        AssertSameDocuments(single.FindTopDocuments(query, predicate), sharded.FindTopDocuments(query, predicate), query);
+
+        const int index = i * 7 % 600;
+        if (index % 9 != 0) {
+            const auto [single_words, single_status] = single.MatchDocument(query, document_id(index));
+            const auto [sharded_words, sharded_status] = sharded.MatchDocument(query, document_id(index));
+            ASSERT_HINT(single_words == sharded_words, query);
+            ASSERT_HINT(single_status == sharded_status, query);
+        }
+    }
+}
+
+void TestWriteAheadLogRecoversIndex() {
+    TemporaryDirectory directory;
+    const std::string log_path = directory.GetPath("index.log"s);
+    WriteAheadLogOptions options;
+    options.recovery_threads = 3;
+    options.recovery_batch_size = 16;
+
+    std::string expected;
+    {
+        SearchServer search_server("common"s);
+        WriteAheadLog log(search_server, log_path, options);
+        ASSERT_EQUAL(log.GetRecoveryStats().log_records, 0u);
+        AddLoggedDocuments(search_server, log, 0, 200);
+        for (int id = 0; id < 200; id += 3) {
+            RemoveLoggedDocument(search_server, log, id);
+        }
+        // повторное добавление удалённого id
+        AddLoggedDocuments(search_server, log, 0, 1);
+        const uint64_t sequence = log.LogRemoveDocument(1000);
+        log.WaitDurable(sequence);
+        ASSERT(log.GetDurableSequence() >= sequence);
+        expected = DumpIndex(search_server);
+    }
+
+    SearchServer search_server("common"s);
+    WriteAheadLog log(search_server, log_path, options);
+    const auto& stats = log.GetRecoveryStats();
+    ASSERT_EQUAL(stats.log_records, 200u + 67u + 1u + 1u);
+    // удаление несуществующего документа отклоняется так же, как при записи
+    ASSERT_EQUAL(stats.errors, 0u);
+    ASSERT_EQUAL(stats.truncated_bytes, 0u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 200 - 67 + 1);
+    ASSERT(DumpIndex(search_server) == expected);
+}
+
+void TestWriteAheadLogTruncatesTornTail() {
+    TemporaryDirectory directory;
+    const std::string log_path = directory.GetPath("index.log"s);
+
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path);
+        AddLoggedDocuments(search_server, log, 0, 50);
+        log.Sync();
+    }
+    // запись последнего документа оборвалась посередине
+    ASSERT_EQUAL(truncate(log_path.c_str(), GetFileSize(log_path) - 5), 0);
+
+    std::string expected;
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path);
+        const auto& stats = log.GetRecoveryStats();
+        ASSERT_EQUAL(stats.log_records, 49u);
+        ASSERT(stats.truncated_bytes > 0);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 49);
+        ASSERT(search_server.FindTopDocuments("doc10 word0"s).size() > 0);
+
+        // новые записи идут сразу за последней целой
+        AddLoggedDocuments(search_server, log, 100, 110);
+        log.Sync();
+        expected = DumpIndex(search_server);
+    }
+
+    SearchServer search_server;
+    WriteAheadLog log(search_server, log_path);
+    ASSERT_EQUAL(log.GetRecoveryStats().truncated_bytes, 0u);
+    ASSERT_EQUAL(log.GetRecoveryStats().log_records, 59u);
+    ASSERT(DumpIndex(search_server) == expected);
+}
+
+void TestWriteAheadLogCheckpoint() {
+    TemporaryDirectory directory;
+    const std::string log_path = directory.GetPath("index.log"s);
+    const std::string stale_log_path = directory.GetPath("stale.log"s);
+    WriteAheadLogOptions options;
+    options.checkpoint_path = directory.GetPath("index.checkpoint"s);
+
+    std::string expected;
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path, options);
+        AddLoggedDocuments(search_server, log, 0, 100);
+        RemoveLoggedDocument(search_server, log, 7);
+        log.Checkpoint(search_server);
+        AddLoggedDocuments(search_server, log, 100, 120);
+        RemoveLoggedDocument(search_server, log, 8);
+        log.Sync();
+        expected = DumpIndex(search_server);
+    }
+
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path, options);
+        const auto& stats = log.GetRecoveryStats();
+        ASSERT_EQUAL(stats.checkpoint_documents, 99u);
+        ASSERT_EQUAL(stats.log_records, 21u);
+        ASSERT_EQUAL(stats.skipped_records, 0u);
+        ASSERT(DumpIndex(search_server) == expected);
+
+        // сбой после записи контрольной точки, но до того, как журнал начат заново:
+        // его записи уже вошли в точку и должны быть пропущены
+        CopyFile(log_path, stale_log_path);
+        log.Checkpoint(search_server);
+    }
+    CopyFile(stale_log_path, log_path);
+
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path, options);
+        const auto& stats = log.GetRecoveryStats();
+        ASSERT_EQUAL(stats.checkpoint_documents, 118u);
+        ASSERT_EQUAL(stats.skipped_records, 21u);
+        ASSERT_EQUAL(stats.log_records, 0u);
+        ASSERT(DumpIndex(search_server) == expected);
+    }
+
+    // повреждённая контрольная точка - не оборванный хвост, восстановление отказывается
+    {
+        std::fstream checkpoint(options.checkpoint_path, std::ios::in | std::ios::out | std::ios::binary);
+        checkpoint.seekp(40);
+        checkpoint.put('#');
+    }
+    bool rejected = false;
+    try {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path, options);
+    }
+    catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    ASSERT(rejected);
+}
+
+void TestQueryServerLogsOnlyAppliedChanges() {
+    TemporaryDirectory directory;
+    const std::string log_path = directory.GetPath("index.log"s);
+
+    std::string expected;
+    {
+        SearchServer search_server;
+        WriteAheadLog log(search_server, log_path);
+        QueryServer server(search_server, 0, 1, &log);
+        ASSERT_EQUAL(server.ProcessCommand("ADD 1 ACTUAL 5 white cat"s), "OK"s);
+        ASSERT_EQUAL(server.ProcessCommand("ADD 2 ACTUAL 3 black dog"s), "OK"s);
+        // занятый и отрицательный id, удаление неизвестного id
+        ASSERT(server.ProcessCommand("ADD 1 ACTUAL 1 other text"s).rfind("ERR"s, 0) == 0);
+        ASSERT(server.ProcessCommand("ADD -3 ACTUAL 1 other text"s).rfind("ERR"s, 0) == 0);
+        ASSERT_EQUAL(server.ProcessCommand("REMOVE 7"s), "OK"s);
+        // бюджет памяти исчерпан
+        search_server.SetMemoryBudget(search_server.GetMemoryUsage().GetTotal());
+        ASSERT(server.ProcessCommand("ADD 3 ACTUAL 1 grey parrot"s).rfind("ERR"s, 0) == 0);
+        search_server.SetMemoryBudget(0);
+        ASSERT_EQUAL(server.ProcessCommand("REMOVE 2"s), "OK"s);
+
+        const auto stats = log.GetStats();
+        ASSERT_EQUAL(stats.records, 3u);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+        expected = DumpIndex(search_server);
+    }
+
+    SearchServer search_server;
+    WriteAheadLog log(search_server, log_path);
+    ASSERT_EQUAL(log.GetRecoveryStats().log_records, 3u);
+    ASSERT_EQUAL(log.GetRecoveryStats().errors, 0u);
+    ASSERT(DumpIndex(search_server) == expected);
+}
+
+void TestQueryServerDoesNotWaitForLog() {
+    using namespace std::chrono;
+    TemporaryDirectory directory;
+    WriteAheadLogOptions options;
+    // сброс журнала заметно дольше поиска
+    options.max_commit_delay = milliseconds(1500);
+
+    SearchServer search_server;
+    search_server.AddDocument(7, "black cat"s, DocumentStatus::ACTUAL, { 1 });
+    WriteAheadLog log(search_server, directory.GetPath("index.log"s), options);
+    // один рабочий поток обслуживает оба соединения
+    QueryServer server(search_server, 0, 1, &log);
+    std::thread server_thread([&server] {
+        server.Run();
+    });
+
+    {
+        LineClient writer(server.GetPort());
+        LineClient reader(server.GetPort());
+        const auto start = steady_clock::now();
+        writer.Send("ADD 1 ACTUAL 5 white cat\nSEARCH cat\n"s);
+        // изменение уже в индексе, ответ на него ещё ждёт журнала
+        while (log.GetStats().records == 0) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+        reader.Send("SEARCH cat\n"s);
+        ASSERT(reader.ReadLine().rfind("OK 2 "s, 0) == 0);
+        ASSERT(steady_clock::now() - start < milliseconds(1000));
+        ASSERT_EQUAL(log.GetDurableSequence(), 0u);
+
+        // ответы писателя - в порядке команд и только после сброса записи
+        ASSERT_EQUAL(writer.ReadLine(), "OK"s);
+        ASSERT(log.GetDurableSequence() >= 1u);
+        ASSERT(writer.ReadLine().rfind("OK 2 "s, 0) == 0);
+
+        // после сброса ответы снова идут сразу
+        reader.Send("REMOVE 7\nSEARCH cat\n"s);
+        ASSERT_EQUAL(reader.ReadLine(), "OK"s);
+        ASSERT(reader.ReadLine().rfind("OK 1 1 "s, 0) == 0);
+    }
+
+    server.Stop();
+    server_thread.join();
+}
+
+void TestTfIdfRankingIsStable() {
+    SearchServer search_server("and in on"s);
+    // id 50 добавлен раньше 10, а при равных релевантности и рейтинге идёт после него
+    search_server.AddDocument(50, "cat long white collar"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    search_server.AddDocument(4, "groomed starling eugene"s, DocumentStatus::ACTUAL, { 9 });
+    search_server.AddDocument(10, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(6, "starling and fluffy dog"s, DocumentStatus::ACTUAL, { 0 });
+
+    // шесть документов: fluffy и groomed - в двух, cat - в трёх
+    const double idf_fluffy = std::log(6.0 / 2);
+    const double idf_groomed = std::log(6.0 / 2);
+    const double idf_cat = std::log(6.0 / 3);
+    const std::vector<Document> expected = {
+        { 2, 0.5 * idf_fluffy + 0.25 * idf_cat, 5 },
+        { 4, idf_groomed / 3, 9 },
+        { 6, idf_fluffy / 3, 0 },
+        { 3, 0.25 * idf_groomed, -1 },
+        { 10, 0.25 * idf_cat, 2 },
+    };
+    const std::vector<Document> expected_minus = {
+        { 2, 0.5 * idf_fluffy + 0.25 * idf_cat, 5 },
+        { 4, idf_groomed / 3, 9 },
+        { 10, 0.25 * idf_cat, 2 },
+        { 50, 0.25 * idf_cat, 2 },
+    };
+
+    const auto check = [&search_server](const std::vector<Document>& expected, const std::string& query, const std::string& stage) {
+        const auto assert_expected = [&](const std::vector<Document>& actual, const std::string& policy) {
+            const std::string hint = stage + ", "s + policy + ": "s + query;
+            ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+                ASSERT_HINT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12, hint);
+                ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+            }
+        };
+        assert_expected(search_server.FindTopDocuments(query), "default"s);
+        assert_expected(search_server.FindTopDocuments(std::execution::seq, query), "seq"s);
+        assert_expected(search_server.FindTopDocuments(std::execution::par, query), "par"s);
+        assert_expected(search_server.FindTopDocuments(PartitionedPolicy{ 3 }, query), "partitioned"s);
+    };
+    const auto check_all = [&](const std::string& stage) {
+        check(expected, "fluffy groomed cat"s, stage);
+        check(expected_minus, "fluffy groomed cat -dog"s, stage);
+    };
+
+    check_all("insertion order"s);
+    search_server.ReorderDocuments(DocumentOrder::RATING);
+    check_all("rating order"s);
+    search_server.ReorderDocuments(DocumentOrder::CONTENT);
+    check_all("content order"s);
+
+    // повторно добавленный документ получает новый внутренний номер
+    search_server.RemoveDocument(10);
+    search_server.AddDocument(10, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    check_all("re-added"s);
+    search_server.RemoveDocument(std::execution::par, 2);
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.ReorderDocuments(DocumentOrder::RATING);
+    check_all("re-added, rating order"s);
+}
+
+void TestMatchDocumentUnknownId() {
+    SearchServer search_server;
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.RemoveDocument(2);
+    ShardedSearchServer sharded_server(""s, 2);
+    sharded_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+
+    const auto throws_out_of_range = [](auto match) {
+        try {
+            match();
+        }
+        catch (const std::out_of_range&) {
+            return true;
+        }
+        return false;
+    };
+    for (const int document_id : { 2, 3, -1 }) {
+        const std::string hint = std::to_string(document_id);
+        ASSERT_HINT(throws_out_of_range([&] { search_server.MatchDocument("cat"s, document_id); }), hint);
+        ASSERT_HINT(throws_out_of_range([&] { search_server.MatchDocument(std::execution::seq, "cat"s, document_id); }), hint);
+        ASSERT_HINT(throws_out_of_range([&] { search_server.MatchDocument(std::execution::par, "cat"s, document_id); }), hint);
+        ASSERT_HINT(throws_out_of_range([&] { sharded_server.MatchDocument("cat"s, document_id); }), hint);
+    }
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("cat"s, 1)).size(), 1u);
+}
+
+void TestQueryPlannerChoosesMode() {
+    SearchServer search_server;
+    for (int id = 0; id < 4000; ++id) {
+        std::string text = "w"s + std::to_string(id % 10) + " v"s + std::to_string(id % 5) + " unique"s + std::to_string(id);
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 10 });
+    }
+
+    // модель задана явно: выбор не зависит от замеров и числа процессоров машины
+    QueryPlanner planner(search_server, false);
+    QueryCostModel model;
+    model.threads = 4;
+    planner.SetCostModel(model);
+
+    const auto single = planner.Plan("unique17"s);
+    ASSERT(single.mode == ExecutionMode::SEQUENTIAL);
+    ASSERT_EQUAL(single.term_count, 1u);
+    ASSERT_EQUAL(single.posting_count, 1u);
+
+    const std::string broad_query = "w0 w1 w2 w3 w4 w5 w6 w7 w8 w9 v0 v1 v2 v3 v4"s;
+    const auto broad = planner.Plan(broad_query);
+    ASSERT(broad.mode != ExecutionMode::SEQUENTIAL);
+    ASSERT_EQUAL(broad.term_count, 15u);
+    ASSERT_EQUAL(broad.posting_count, 8000u);
+    ASSERT_EQUAL(broad.max_posting_count, 800u);
+    ASSERT(std::min(broad.parallel_cost_us, broad.partitioned_cost_us) < broad.sequential_cost_us);
+
+    // на одном потоке параллельные способы не выбираются
+    model.threads = 1;
+    planner.SetCostModel(model);
+    ASSERT(planner.Plan(broad_query).mode == ExecutionMode::SEQUENTIAL);
+    model.threads = 4;
+    planner.SetCostModel(model);
+
+    // результат не зависит от выбранного способа; считаются только запросы поиска
+    AssertSameDocuments(search_server.FindTopDocuments(broad_query), planner.FindTopDocuments(broad_query), broad_query);
+    AssertSameDocuments(search_server.FindTopDocuments("unique17"s), planner.FindTopDocuments("unique17"s), "unique17"s);
+    planner.MatchDocument("w7 unique17"s, 17);
+    planner.RemoveDocument(17);
+    const auto counts = planner.GetModeCounts();
+    ASSERT_EQUAL(counts[static_cast<size_t>(ExecutionMode::SEQUENTIAL)], 1u);
+    ASSERT_EQUAL(counts[static_cast<size_t>(broad.mode)], 1u);
+    ASSERT_EQUAL(counts[0] + counts[1] + counts[2], 2u);
+
+    // замеренная модель: обработка элемента списка документов не бесплатна
+    planner.Calibrate();
+    ASSERT(planner.GetCostModel().sequential.per_posting_us > 0.0);
+    ASSERT(planner.GetCostModel().sequential.fixed_us >= 0.0);
+}
+
+void TestFuzzyTermIndexMatches() {
+    const auto to_string = [](const std::vector<FuzzyTermIndex::Match>& matches) {
+        std::string result;
+        for (const auto& match : matches) {
+            result += match.term + ":"s + std::to_string(match.distance) + " "s;
+        }
+        return result;
+    };
+
+    FuzzyTermIndex index(2);
+    index.Build({ "act", "cart", "cat", "coat", "dog", "kitten", "mitten", "sitting" });
+    ASSERT_EQUAL(to_string(index.FindMatches("cat", 1)), "cat:0 cart:1 coat:1 "s);
+    // перестановка "cat" -> "act" стоит двух правок
+    ASSERT_EQUAL(to_string(index.FindMatches("cat", 2)), "cat:0 cart:1 coat:1 act:2 "s);
+    ASSERT_EQUAL(to_string(index.FindMatches("kitten", 2)), "kitten:0 mitten:1 "s);
+    ASSERT_EQUAL(to_string(index.FindMatches("kiten", 1)), "kitten:1 "s);
+    ASSERT_EQUAL(to_string(index.FindMatches("mittens", 2)), "mitten:1 kitten:2 "s);
+    // kitten -> sitting - три правки, больше max_edits индекса
+    ASSERT_EQUAL(to_string(index.FindMatches("siting", 5)), "sitting:1 "s);
+    ASSERT(index.FindMatches("horse", 2).empty());
+
+    // термины, добавленные после построения, находятся до перестройки
+    index.Add("cot");
+    index.Add("cat");
+    ASSERT_EQUAL(to_string(index.FindMatches("cat", 1)), "cat:0 cart:1 coat:1 cot:1 "s);
+    ASSERT(!index.NeedsRebuild());
+
+    FuzzyTermIndex single_edit(1);
+    single_edit.Build({ "cat", "coat", "cost" });
+    ASSERT_EQUAL(to_string(single_edit.FindMatches("cst", 2)), "cat:1 cost:1 "s);
+}
+
+void TestFuzzySearch() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cats"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "house garden"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "kitten"s, DocumentStatus::ACTUAL, { 4 });
+    search_server.AddDocument(5, "ox"s, DocumentStatus::ACTUAL, { 5 });
+    search_server.AddDocument(6, "cas"s, DocumentStatus::ACTUAL, { 6 });
+
+    const auto ids = [&search_server](std::string_view query) {
+        std::vector<int> result;
+        for (const auto& document : search_server.FindTopDocuments(query)) {
+            result.push_back(document.id);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    // без нечёткого поиска только точные совпадения
+    ASSERT(ids("kiten").empty());
+    search_server.SetFuzzyOptions({ 2, 0.5, 16 });
+
+    // слово из 3-5 символов - одна правка
+    ASSERT(ids("cas") == std::vector<int>({ 1, 2, 6 }));
+    ASSERT(ids("kiten") == std::vector<int>({ 4 }));
+    // перестановка в слове короче 6 символов - две правки, не совпадает
+    ASSERT(ids("hosue").empty());
+    // от 6 символов - две правки
+    ASSERT(ids("gadren") == std::vector<int>({ 3 }));
+    ASSERT(ids("kittnes") == std::vector<int>({ 4 }));
+    // слово короче 3 символов - без опечаток
+    ASSERT(ids("ax").empty());
+    ASSERT(ids("ox") == std::vector<int>({ 5 }));
+
+    // точное совпадение выше нечёткого, вклад нечёткого умножен на penalty
+    const auto documents = search_server.FindTopDocuments("cas"s);
+    ASSERT_EQUAL(documents.front().id, 6);
+    for (size_t i = 1; i < documents.size(); ++i) {
+        ASSERT(documents[i].relevance < documents.front().relevance);
+    }
+    const auto [matched, status] = search_server.MatchDocument("kiten", 4);
+    ASSERT(matched == std::vector<std::string_view>({ "kitten" }));
+
+    // max_edits = 1 ограничивает и длинные слова
+    search_server.SetFuzzyOptions({ 1, 0.5, 16 });
+    ASSERT(ids("gadren").empty());
+    ASSERT(ids("gardens") == std::vector<int>({ 3 }));
+
+    // термин удалённого документа остаётся в индексе удалений до перестройки,
+    // но в раскрытие не попадает
+    search_server.RemoveDocument(4);
+    ASSERT(ids("kiten").empty());
+    ASSERT(ids("kitten").empty());
+    search_server.AddDocument(7, "mitten"s, DocumentStatus::ACTUAL, { 7 });
+    ASSERT(ids("kitten") == std::vector<int>({ 7 }));
+}
+
+void TestMemoryAccountingAndBudget() {
+    SearchServer search_server("and in"s);
+    const auto empty = search_server.GetMemoryUsage();
+    ASSERT(empty.stop_words > 0);
+    ASSERT_EQUAL(empty.dictionary, 0u);
+    ASSERT_EQUAL(empty.postings, 0u);
+    ASSERT_EQUAL(empty.forward_index, 0u);
+
+    for (int id = 0; id < 50; ++id) {
+        search_server.AddDocument(id, "cat"s + std::to_string(id) + " and dog in the city number"s + std::to_string(id % 7),
+            DocumentStatus::ACTUAL, { id });
+    }
+    const auto filled = search_server.GetMemoryUsage();
+    ASSERT(filled.dictionary > empty.dictionary);
+    ASSERT(filled.postings > empty.postings);
+    ASSERT(filled.forward_index > empty.forward_index);
+    ASSERT(filled.document_store > empty.document_store);
+    ASSERT_EQUAL(filled.stop_words, empty.stop_words);
+
+    // документ сверх бюджета: исключение, индекс и его учёт не меняются
+    search_server.SetMemoryBudget(filled.GetTotal() + 64);
+    const auto before = search_server.FindTopDocuments("cat7 city"s);
+    bool rejected = false;
+    try {
+        search_server.AddDocument(100, "a long document about a cat and a dog walking in a big city"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    catch (const std::length_error&) {
+        rejected = true;
+    }
+    ASSERT(rejected);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 50);
+    ASSERT(search_server.GetWordFrequencies(100).empty());
+    ASSERT_EQUAL(search_server.GetMemoryUsage().GetTotal(), filled.GetTotal());
+    ASSERT(search_server.FindTopDocuments("walking"s).empty());
+    const auto after = search_server.FindTopDocuments("cat7 city"s);
+    ASSERT_EQUAL(after.size(), before.size());
+    for (size_t i = 0; i < after.size(); ++i) {
+        ASSERT_EQUAL(after[i].id, before[i].id);
+    }
+    search_server.SetMemoryBudget(0);
+    search_server.AddDocument(100, "a long document about a cat and a dog walking in a big city"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.FindTopDocuments("walking"s).size(), 1u);
+
+    // после удаления всех документов слова и списки документов освобождены
+    search_server.RemoveDocument(100);
+    for (int id = 0; id < 50; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    const auto cleared = search_server.GetMemoryUsage();
+    ASSERT_EQUAL(cleared.dictionary, empty.dictionary);
+    ASSERT_EQUAL(cleared.postings, empty.postings);
+    ASSERT_EQUAL(cleared.forward_index, empty.forward_index);
+    ASSERT_EQUAL(cleared.document_store, empty.document_store);
+}
+
+void TestRemovedDocumentSlotsAreReclaimed() {
+    SearchServer search_server;
+    const auto empty = search_server.GetMemoryUsage();
+    for (int id = 0; id < 2000; ++id) {
+        search_server.AddDocument(id, "word"s + std::to_string(id % 17) + " common"s, DocumentStatus::ACTUAL, { id % 5 });
+    }
+    for (int id = 0; id < 2000; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(search_server.GetMemoryUsage().GetTotal(), empty.GetTotal());
+
+    // при постоянной замене документов память ограничена числом живых документов
+    for (int id = 0; id < 100; ++id) {
+        search_server.AddDocument(id, "word"s + std::to_string(id % 17) + " common"s, DocumentStatus::ACTUAL, { id % 5 });
+    }
+    search_server.ReorderDocuments(DocumentOrder::RATING);
+    const size_t steady = search_server.GetMemoryUsage().document_store;
+    size_t peak = 0;
+    for (int id = 100; id < 20000; ++id) {
+        search_server.RemoveDocument(id - 100);
+        search_server.AddDocument(id, "word"s + std::to_string(id % 17) + " common"s, DocumentStatus::ACTUAL, { id % 5 });
+        peak = std::max(peak, search_server.GetMemoryUsage().document_store);
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 100);
+    ASSERT_HINT(peak < 4 * steady, std::to_string(peak) + " vs "s + std::to_string(steady));
+
+    // после перенумерации поиск и MatchDocument видят те же документы
+    SearchServer reference;
+    for (int id = 19900; id < 20000; ++id) {
+        reference.AddDocument(id, "word"s + std::to_string(id % 17) + " common"s, DocumentStatus::ACTUAL, { id % 5 });
+    }
+    for (const std::string& query : { "word3"s, "word5 -common"s, "common word16"s }) {
+        AssertSameDocuments(reference.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        AssertSameDocuments(reference.FindTopDocuments(std::execution::par, query),
+            search_server.FindTopDocuments(std::execution::par, query), query);
+    }
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("word3 common"s, 19910)).size(), 2u);
+}
+
+void TestSearchServerCopy() {
+    std::unique_ptr<SearchServer> original = std::make_unique<SearchServer>("and in"s);
+    for (int id = 0; id < 40; ++id) {
+        original->AddDocument(id, "cat"s + std::to_string(id % 5) + " and dog in city"s + std::to_string(id % 3),
+            DocumentStatus::ACTUAL, { id % 10 });
+    }
+    original->RemoveDocument(3);
+    original->SetFuzzyOptions({ 1, 0.5, 16 });
+    original->SetMemoryBudget(1 << 20);
+
+    SearchServer copy(*original);
+    ASSERT_EQUAL(copy.GetDocumentCount(), original->GetDocumentCount());
+    ASSERT_EQUAL(copy.GetMemoryBudget(), original->GetMemoryBudget());
+    ASSERT_EQUAL(copy.GetFuzzyOptions().max_edits, 1);
+    const auto original_usage = original->GetMemoryUsage();
+    const auto copy_usage = copy.GetMemoryUsage();
+    ASSERT_EQUAL(copy_usage.dictionary, original_usage.dictionary);
+    ASSERT_EQUAL(copy_usage.postings, original_usage.postings);
+    ASSERT_EQUAL(copy_usage.forward_index, original_usage.forward_index);
+    const auto expected = original->FindTopDocuments("cat1 ciyt2"s);
+    ASSERT(!expected.empty());
+
+    // изменения копии не видны в исходном индексе, и копия не ссылается на его тексты
+    copy.RemoveDocument(1);
+    ASSERT_EQUAL(original->GetDocumentCount(), 39);
+    ASSERT_EQUAL(copy.GetDocumentCount(), 38);
+    original->AddDocument(1000, "cat1 city2"s, DocumentStatus::ACTUAL, { 1 });
+    original.reset();
+    const auto actual = copy.FindTopDocuments("cat1 ciyt2"s);
+    ASSERT_EQUAL(actual.size(), expected.size());
+    for (const auto& document : actual) {
+        ASSERT(document.id != 1 && document.id != 1000);
+    }
+    ASSERT_EQUAL(std::get<0>(copy.MatchDocument("cat1 city2"s, 6)).size(), 2u);
+}
+
+void TestSearchBrokerMatchesSingleServer() {
+    LocalShards shards(3);
+    SearchBroker broker(shards.GetAddresses());
+    SearchServer search_server("and in"s);
+
+    std::mt19937 generator(7);
+    std::vector<std::string> dictionary;
+    for (int i = 0; i < 150; ++i) {
+        dictionary.push_back(GenerateWord(generator));
+    }
+    for (int index = 0; index < 300; ++index) {
+        const int document_id = index * 2 + 1;
+        const std::string text = GenerateText(generator, dictionary, std::uniform_int_distribution(3, 12)(generator));
+        const DocumentStatus status = index % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        const std::vector<int> ratings = { std::uniform_int_distribution(-5, 10)(generator), index % 4 };
+        search_server.AddDocument(document_id, text, status, ratings);
+        broker.AddDocument(document_id, text, status, ratings);
+    }
+    for (int document_id = 1; document_id < 600; document_id += 22) {
+        search_server.RemoveDocument(document_id);
+        broker.RemoveDocument(document_id);
+    }
+    ASSERT_EQUAL(broker.GetDocumentCount(), search_server.GetDocumentCount());
+
+    // ошибки шарда доходят до вызывающего
+    bool rejected = false;
+    try {
+        broker.AddDocument(3, "duplicate"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    ASSERT(rejected);
+
+    for (int i = 0; i < 100; ++i) {
+        std::string query = GenerateText(generator, dictionary, std::uniform_int_distribution(1, 4)(generator));
+        if (i % 5 == 0) {
+            query += "-"s + dictionary[i];
+        }
+        AssertSameDocuments(search_server.FindTopDocuments(query), broker.FindTopDocuments(query), query);
+
+        const int document_id = 3 + 2 * (i % 250);
+        if (search_server.GetWordFrequencies(document_id).empty()) {
+            continue;
+        }
+        const auto [expected_words, expected_status] = search_server.MatchDocument(query, document_id);
+        const auto [words, status] = broker.MatchDocument(query, document_id);
+        ASSERT_HINT(std::vector<std::string>(expected_words.begin(), expected_words.end()) == words, query);
+        ASSERT_HINT(status == expected_status, query);
+    }
+    ASSERT_EQUAL(broker.GetPartialResultCount(), 0u);
+}
+
+void TestSearchBrokerUnavailableShard() {
+    LocalShards shards(3);
+    SearchBroker broker(shards.GetAddresses());
+    std::vector<SearchServer> live_servers(2, SearchServer("and in"s));
+    std::mt19937 generator(11);
+    std::vector<std::string> dictionary;
+    for (int i = 0; i < 60; ++i) {
+        dictionary.push_back(GenerateWord(generator));
+    }
+    for (int document_id = 0; document_id < 200; ++document_id) {
+        const std::string text = GenerateText(generator, dictionary, 6);
+        broker.AddDocument(document_id, text, DocumentStatus::ACTUAL, { document_id % 7 });
+        const size_t shard = broker.GetShardIndex(document_id);
+        if (shard < 2) {
+            live_servers[shard].AddDocument(document_id, text, DocumentStatus::ACTUAL, { document_id % 7 });
+        }
+    }
+    // те же документы в одном индексе - ожидаемый ответ без третьего шарда
+    SearchServer live_index("and in"s);
+    for (const auto& server : live_servers) {
+        for (const int document_id : server) {
+            const auto document = server.GetStoredDocument(document_id);
+            live_index.AddDocument(document_id, document.text, document.status, { document.rating });
+        }
+    }
+
+    BrokerOptions options;
+    options.timeout = std::chrono::milliseconds(200);
+    const auto addresses = shards.GetAddresses();
+    const SilentShard silent_shard;
+    std::vector<ShardAddress> stalled_addresses = { addresses[0], addresses[1], silent_shard.GetAddress() };
+
+    // молчащий шард: ответ остальных не позже тайм-аута на каждую из двух фаз
+    SearchBroker partial_broker(stalled_addresses, options);
+    const std::string query = dictionary[0] + " "s + dictionary[1] + " "s + dictionary[2];
+    const auto start = std::chrono::steady_clock::now();
+    const auto documents = partial_broker.FindTopDocuments(query);
+    ASSERT(std::chrono::steady_clock::now() - start < 4 * options.timeout);
+    ASSERT(!documents.empty());
+    AssertSameDocuments(live_index.FindTopDocuments(query), documents, query);
+    ASSERT_EQUAL(partial_broker.GetPartialResultCount(), 1u);
+
+    options.allow_partial_results = false;
+    SearchBroker strict_broker(stalled_addresses, options);
+    bool failed = false;
+    try {
+        strict_broker.FindTopDocuments(query);
+    }
+    catch (const std::runtime_error&) {
+        failed = true;
+    }
+    ASSERT(failed);
+
+    // шард отключился после установки соединения: частичный ответ, а изменения
+    // его документов - ошибка; шарды, ответившие раньше, продолжают работать
+    broker.FindTopDocuments(query);
+    ASSERT_EQUAL(broker.GetPartialResultCount(), 0u);
+    shards.Stop(2);
+    AssertSameDocuments(live_index.FindTopDocuments(query), broker.FindTopDocuments(query), query);
+    ASSERT_EQUAL(broker.GetPartialResultCount(), 1u);
+    failed = false;
+    try {
+        broker.RemoveDocument(2);
+    }
+    catch (const std::runtime_error&) {
+        failed = true;
+    }
+    ASSERT(failed);
+    broker.RemoveDocument(0);
+    live_index.RemoveDocument(0);
+    const std::string second_query = dictionary[3] + " "s + dictionary[4];
+    AssertSameDocuments(live_index.FindTopDocuments(second_query), broker.FindTopDocuments(second_query), second_query);
+}
+
+void TestRequestQueueLatencyPercentiles() {
+    const SearchServer search_server;
+    RequestQueue requests(search_server);
+    for (int latency = 1; latency <= 1000; ++latency) {
+        requests.RecordRequest(latency % 4 != 0, std::chrono::microseconds(latency));
+    }
+    const auto stats = requests.GetWindowStats();
+    ASSERT_EQUAL(stats.requests, 1000u);
+    ASSERT_EQUAL(stats.no_result_requests, 250u);
+    const auto assert_close = [](std::chrono::microseconds actual, int64_t expected) {
+        ASSERT_HINT(std::abs(actual.count() - expected) <= expected / 32 + 1,
+            std::to_string(actual.count()) + " vs "s + std::to_string(expected));
+    };
+    assert_close(stats.latency_p50, 500);
+    assert_close(stats.latency_p90, 900);
+    assert_close(stats.latency_p99, 990);
+
+    // короткие задержки считаются точно, очень долгие - в последнем интервале
+    RequestQueue short_requests(search_server);
+    short_requests.RecordRequest(true, std::chrono::microseconds(7));
+    ASSERT_EQUAL(short_requests.GetBucketStats(0).latency_p99.count(), 7);
+    RequestQueue long_requests(search_server);
+    long_requests.RecordRequest(true, std::chrono::minutes(10));
+    ASSERT(long_requests.GetWindowStats().latency_p50 >= std::chrono::seconds(60));
+}
+
+void TestRequestQueueRecordsAcrossRollover() {
+    const SearchServer search_server;
+    // окно из трёх интервалов по секунде: запись длится дольше двух смен интервала,
+    // но меньше окна, поэтому ни один запрос не должен выпасть
+    RequestQueue requests(search_server, std::chrono::seconds(1), 3);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2200);
+    std::atomic<uint64_t> recorded{ 0 };
+    std::atomic<uint64_t> recorded_no_result{ 0 };
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&, thread] {
+            uint64_t count = 0;
+            uint64_t no_result = 0;
+            while (std::chrono::steady_clock::now() < deadline) {
+                const bool has_result = (count + thread) % 3 != 0;
+                requests.RecordRequest(has_result, std::chrono::microseconds(100 + count % 50));
+                ++count;
+                no_result += has_result ? 0 : 1;
+            }
+            recorded += count;
+            recorded_no_result += no_result;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQUAL(requests.GetRequestCount(), recorded.load());
+    ASSERT_EQUAL(static_cast<uint64_t>(requests.GetNoResultRequests()), recorded_no_result.load());
+    uint64_t bucket_requests = 0;
+    size_t non_empty_buckets = 0;
+    for (size_t buckets_ago = 0; buckets_ago < 3; ++buckets_ago) {
+        const auto stats = requests.GetBucketStats(buckets_ago);
+        bucket_requests += stats.requests;
+        non_empty_buckets += stats.requests > 0 ? 1 : 0;
+    }
+    ASSERT_EQUAL(bucket_requests, recorded.load());
+    ASSERT(non_empty_buckets >= 2);
+    const auto window = requests.GetWindowStats();
+    ASSERT(window.latency_p50 >= std::chrono::microseconds(100) && window.latency_p99 <= std::chrono::microseconds(160));
+
+    // через длину окна все интервалы истекли, суммы окна не уходят ниже нуля
+    std::this_thread::sleep_for(std::chrono::milliseconds(3100));
+    ASSERT_EQUAL(requests.GetRequestCount(), 0u);
+    ASSERT_EQUAL(requests.GetNoResultRequests(), 0);
+    ASSERT_EQUAL(requests.GetWindowStats().latency_p99.count(), 0);
+}
+
+void TestSearchServer() {
+    RUN_TEST(TestShardedSearchMatchesSingleServer);
+    RUN_TEST(TestWriteAheadLogRecoversIndex);
+    RUN_TEST(TestWriteAheadLogTruncatesTornTail);
+    RUN_TEST(TestWriteAheadLogCheckpoint);
+    RUN_TEST(TestQueryServerLogsOnlyAppliedChanges);
+    RUN_TEST(TestQueryServerDoesNotWaitForLog);
+    RUN_TEST(TestTfIdfRankingIsStable);
+    RUN_TEST(TestMatchDocumentUnknownId);
+    RUN_TEST(TestQueryPlannerChoosesMode);
+    RUN_TEST(TestFuzzyTermIndexMatches);
+    RUN_TEST(TestFuzzySearch);
+    RUN_TEST(TestMemoryAccountingAndBudget);
+    RUN_TEST(TestRemovedDocumentSlotsAreReclaimed);
+    RUN_TEST(TestSearchServerCopy);
+    RUN_TEST(TestSearchBrokerMatchesSingleServer);
+    RUN_TEST(TestSearchBrokerUnavailableShard);
+    RUN_TEST(TestRequestQueueLatencyPercentiles);
+    RUN_TEST(TestRequestQueueRecordsAcrossRollover);
+}
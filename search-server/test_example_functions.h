@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std::string_literals;
+
+// Проверки и запуск тестов: при несовпадении печатается выражение, место и подсказка,
+// и программа завершается через abort()
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file,
+    const std::string& func, unsigned line, const std::string& hint);
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str,
+    const std::string& file, const std::string& func, unsigned line, const std::string& hint) {
+    if (t != u) {
+        std::cerr << std::boolalpha;
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        std::cerr << t << " != "s << u << "."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc& func, const std::string& test_name) {
+    func();
+    std::cerr << test_name << " OK"s << std::endl;
+}
+
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+// шардированный индекс выдаёт те же документы и релевантность, что и единый
+void TestShardedSearchMatchesSingleServer();
+
+// журнал восстанавливает индекс после перезапуска
+void TestWriteAheadLogRecoversIndex();
+// оборванная при сбое последняя запись отбрасывается, журнал пишется дальше
+void TestWriteAheadLogTruncatesTornTail();
+// восстановление из контрольной точки и записей после неё, в том числе
+// когда журнал не успел начаться заново после записи точки
+void TestWriteAheadLogCheckpoint();
+// QueryServer не пишет в журнал изменения, которые индекс отклоняет
+void TestQueryServerLogsOnlyAppliedChanges();
+// пока журнал не сбросил изменение, рабочий поток QueryServer отвечает другим
+// соединениям, а ответы на изменение приходят после сброса и в порядке команд
+void TestQueryServerDoesNotWaitForLog();
+
+// TF-IDF выдаёт ожидаемые id, релевантность и порядок (включая равные по
+// релевантности документы) при seq, par и PartitionedPolicy, после перенумерации
+// и после удаления и повторного добавления документа
+void TestTfIdfRankingIsStable();
+
+// MatchDocument для неизвестного или удалённого id бросает std::out_of_range
+void TestMatchDocumentUnknownId();
+
+// планировщик: запрос из одного редкого слова - последовательно, много слов
+// с длинными списками документов - параллельно; GetModeCounts считает только поиск
+void TestQueryPlannerChoosesMode();
+
+// индекс удалений находит термины на расстоянии 1 и 2 и только их;
+// перестановка соседних букв - две правки, а не одна
+void TestFuzzyTermIndexMatches();
+// нечёткий поиск в SearchServer: пороги по длине слова, штраф за расстояние,
+// термины удалённых документов не раскрываются
+void TestFuzzySearch();
+
+// учёт памяти растёт при добавлении и возвращается при удалении, документ сверх
+// бюджета отклоняется без изменения индекса
+void TestMemoryAccountingAndBudget();
+// номера удалённых документов освобождаются без явного ReorderDocuments
+void TestRemovedDocumentSlotsAreReclaimed();
+// копия индекса независима от исходного и считает память заново
+void TestSearchServerCopy();
+
+// брокер над несколькими процессами-шардами (здесь - QueryServer в этом процессе)
+// выдаёт те же документы и релевантность, что и единый SearchServer
+void TestSearchBrokerMatchesSingleServer();
+// молчащий или отключившийся шард: в режиме частичных ответов - документы остальных
+// шардов, в строгом - std::runtime_error, в обоих случаях не дольше тайм-аута
+void TestSearchBrokerUnavailableShard();
+
+// перцентили задержки отличаются от точных не больше чем на 1/32
+void TestRequestQueueLatencyPercentiles();
+// запросы из нескольких потоков при смене интервалов не теряются и не считаются дважды,
+// а по истечении окна счётчики обнуляются
+void TestRequestQueueRecordsAcrossRollover();
+
+void TestSearchServer();
@@ -0,0 +1,199 @@
+#include "../log_duration.h"
+#include "../query_planner.h"
+#include "../search_server.h"
+#include "../sharded_search_server.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word(length, ' ');
+    for (char& c : word) {
+        c = uniform_int_distribution<int>('a', 'z')(generator);
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text += ' ';
+        }
+        text += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return text;
+}
+
+template <typename QueryMaker>
+vector<string> GenerateQueries(mt19937& generator, int query_count, QueryMaker make_query) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(make_query(generator));
+    }
+    return queries;
+}
+
+template <typename ScoringPolicy = TfIdfScoring, typename ExecutionPolicy>
+void Benchmark(const string& mark, const SearchServer& search_server,
+    const vector<string>& queries, ExecutionPolicy&& policy) {
+    size_t found = 0;
+    {
+        LOG_DURATION(mark);
+        for (const string& query : queries) {
+            found += search_server.FindTopDocuments<ScoringPolicy>(policy, query).size();
+        }
+    }
+    cerr << "  found "s << found << " documents for "s << queries.size() << " queries"s << endl;
+}
+
+void BenchmarkPlanned(const string& mark, const QueryPlanner& planner,
+    const vector<string>& queries) {
+    size_t found = 0;
+    {
+        LOG_DURATION(mark);
+        for (const string& query : queries) {
+            found += planner.FindTopDocuments(query).size();
+        }
+    }
+    const auto counts = planner.GetModeCounts();
+    cerr << "  found "s << found << " documents for "s << queries.size() << " queries"s
+        << ", plans seq/par/partitioned: "s << counts[0] << '/' << counts[1] << '/' << counts[2] << endl;
+}
+
+template <typename ScoringPolicy = TfIdfScoring>
+void BenchmarkSharded(const string& mark, const ShardedSearchServer& search_server,
+    const vector<string>& queries) {
+    size_t found = 0;
+    {
+        LOG_DURATION(mark);
+        for (const string& query : queries) {
+            found += search_server.FindTopDocuments<ScoringPolicy>(query).size();
+        }
+    }
+    cerr << "  found "s << found << " documents for "s << queries.size() << " queries"s << endl;
+}
+
+}  // namespace
+
+// benchmark [documents] [queries] [shards]
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? atoi(argv[1]) : 20000;
+    const int query_count = argc > 2 ? atoi(argv[2]) : 2000;
+    const int shard_count = argc > 3 ? atoi(argv[3]) : 0;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 20000, 10);
+
+    vector<pair<string, int>> documents;
+    documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        const int length = uniform_int_distribution(20, 120)(generator);
+        const int rating = uniform_int_distribution(-10, 10)(generator);
+        documents.emplace_back(GenerateText(generator, dictionary, length), rating);
+    }
+
+    SearchServer search_server(dictionary[0]);
+    {
+        LOG_DURATION("AddDocument"s);
+        for (int i = 0; i < document_count; ++i) {
+            search_server.AddDocument(i, documents[i].first, DocumentStatus::ACTUAL, { documents[i].second });
+        }
+    }
+
+    const auto exact_queries = GenerateQueries(generator, query_count, [&dictionary](mt19937& g) {
+        return GenerateText(g, dictionary, 3);
+    });
+    const auto prefix_queries = GenerateQueries(generator, query_count, [&dictionary](mt19937& g) {
+        string query;
+        for (int i = 0; i < 3; ++i) {
+            const string& word = dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(g)];
+            query += word.substr(0, min<size_t>(word.size(), 3)) + "* "s;
+        }
+        return query;
+    });
+
+    const auto typo_queries = GenerateQueries(generator, query_count, [&dictionary](mt19937& g) {
+        string query;
+        for (int i = 0; i < 3; ++i) {
+            string word = dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(g)];
+            word[uniform_int_distribution<size_t>(0, word.size() - 1)(g)] = uniform_int_distribution<int>('a', 'z')(g);
+            query += word + " "s;
+        }
+        return query;
+    });
+
+    Benchmark("Exact seq"s, search_server, exact_queries, execution::seq);
+    Benchmark("Exact par"s, search_server, exact_queries, execution::par);
+    Benchmark("Prefix seq"s, search_server, prefix_queries, execution::seq);
+    Benchmark("Prefix par"s, search_server, prefix_queries, execution::par);
+    Benchmark("Exact partitioned"s, search_server, exact_queries, PartitionedPolicy{});
+    {
+        QueryPlanner planner(search_server, false);
+        {
+            LOG_DURATION("Planner calibration"s);
+            planner.Calibrate();
+        }
+        BenchmarkPlanned("Exact planned"s, planner, exact_queries);
+    }
+    Benchmark<Bm25Scoring>("Exact BM25 seq"s, search_server, exact_queries, execution::seq);
+    Benchmark<Bm25Scoring>("Exact BM25 par"s, search_server, exact_queries, execution::par);
+    Benchmark<RatingBoostedScoring<Bm25Scoring>>("Exact BM25 + rating seq"s, search_server, exact_queries, execution::seq);
+
+    Benchmark("Typo exact seq"s, search_server, typo_queries, execution::seq);
+    {
+        LOG_DURATION("Fuzzy index(1) build"s);
+        search_server.SetFuzzyOptions({ 1, 0.5, 16 });
+    }
+    Benchmark("Typo fuzzy(1) seq"s, search_server, typo_queries, execution::seq);
+    {
+        LOG_DURATION("Fuzzy index(2) build"s);
+        search_server.SetFuzzyOptions({ 2, 0.5, 16 });
+    }
+    Benchmark("Typo fuzzy(2) seq"s, search_server, typo_queries, execution::seq);
+    Benchmark("Typo fuzzy(2) par"s, search_server, typo_queries, execution::par);
+    search_server.SetFuzzyOptions({});
+
+    for (const auto& [mark, order] : { pair{ "rating"s, DocumentOrder::RATING }, pair{ "content"s, DocumentOrder::CONTENT } }) {
+        {
+            LOG_DURATION("Reorder by "s + mark);
+            search_server.ReorderDocuments(order);
+        }
+        Benchmark("Exact seq, "s + mark + " order"s, search_server, exact_queries, execution::seq);
+        Benchmark("Prefix seq, "s + mark + " order"s, search_server, prefix_queries, execution::seq);
+    }
+
+    if (shard_count > 0) {
+        ShardedSearchServer sharded_server(vector<string>{ dictionary[0] }, shard_count);
+        {
+            LOG_DURATION("Sharded AddDocument"s);
+            for (int i = 0; i < document_count; ++i) {
+                sharded_server.AddDocument(i, documents[i].first, DocumentStatus::ACTUAL, { documents[i].second });
+            }
+        }
+        BenchmarkSharded("Exact sharded"s, sharded_server, exact_queries);
+        BenchmarkSharded("Prefix sharded"s, sharded_server, prefix_queries);
+        BenchmarkSharded<Bm25Scoring>("Exact BM25 sharded"s, sharded_server, exact_queries);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "../search_broker.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// broker [--timeout ms] [--strict] <host:port>...
+// читает команды протокола QueryServer из stdin, ответы пишет в stdout
+int main(int argc, char* argv[]) {
+    BrokerOptions options;
+    vector<ShardAddress> shards;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+                options.timeout = chrono::milliseconds(atoi(argv[++i]));
+            }
+            else if (strcmp(argv[i], "--strict") == 0) {
+                options.allow_partial_results = false;
+            }
+            else {
+                shards.push_back(ParseShardAddress(argv[i]));
+            }
+        }
+
+        SearchBroker broker(move(shards), options);
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            cout << broker.ProcessCommand(line) << '\n';
+            cout.flush();
+        }
+        if (broker.GetPartialResultCount() > 0) {
+            cerr << "Partial results: "s << broker.GetPartialResultCount() << endl;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
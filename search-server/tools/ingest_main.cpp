@@ -0,0 +1,30 @@
+#include "../ingestion.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// ingest <corpus file> [tokenizer threads] [stop words]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: ingest <corpus file> [tokenizer threads] [stop words]"s << endl;
+        return 1;
+    }
+    IngestionOptions options;
+    if (argc > 2) {
+        options.tokenizer_threads = static_cast<size_t>(max(1, atoi(argv[2])));
+    }
+    const string stop_words = argc > 3 ? argv[3] : ""s;
+
+    try {
+        SearchServer search_server(stop_words);
+        const auto stats = IngestFile(search_server, argv[1], options);
+        cout << stats << endl;
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
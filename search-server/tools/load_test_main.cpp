@@ -0,0 +1,195 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+class LineClient {
+public:
+    explicit LineClient(uint16_t port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            throw runtime_error("Can't connect to port "s + to_string(port));
+        }
+        const int enable = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+
+    ~LineClient() {
+        close(fd_);
+    }
+
+    void Send(const string& data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            const ssize_t written = send(fd_, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+            if (written <= 0) {
+                throw runtime_error("Connection closed"s);
+            }
+            offset += written;
+        }
+    }
+
+    string ReadLine() {
+        while (true) {
+            const auto newline = buffer_.find('\n');
+            if (newline != buffer_.npos) {
+                string line = buffer_.substr(0, newline);
+                buffer_.erase(0, newline + 1);
+                return line;
+            }
+            char chunk[16 * 1024];
+            const ssize_t readed = recv(fd_, chunk, sizeof(chunk), 0);
+            if (readed <= 0) {
+                throw runtime_error("Connection closed"s);
+            }
+            buffer_.append(chunk, readed);
+        }
+    }
+
+private:
+    int fd_;
+    string buffer_;
+};
+
+string RandomWord(mt19937& generator, int vocabulary_size) {
+    return "w"s + to_string(uniform_int_distribution<int>(0, vocabulary_size - 1)(generator));
+}
+
+string RandomText(mt19937& generator, int vocabulary_size, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text += ' ';
+        }
+        text += RandomWord(generator, vocabulary_size);
+    }
+    return text;
+}
+
+void Populate(uint16_t port, int document_count, int vocabulary_size) {
+    LineClient client(port);
+    mt19937 generator(1);
+    string batch;
+    for (int id = 0; id < document_count; ++id) {
+        batch += "ADD "s + to_string(id) + " ACTUAL "s + to_string(id % 10) + " "s
+            + RandomText(generator, vocabulary_size, 20) + "\n"s;
+    }
+    client.Send(batch);
+    for (int id = 0; id < document_count; ++id) {
+        client.ReadLine();
+    }
+}
+
+// держит pipeline_depth запросов в полёте и возвращает задержки в микросекундах
+vector<int64_t> RunConnection(uint16_t port, int request_count, int pipeline_depth,
+    int vocabulary_size, unsigned seed) {
+    LineClient client(port);
+    mt19937 generator(seed);
+    deque<Clock::time_point> in_flight;
+    vector<int64_t> latencies;
+    latencies.reserve(request_count);
+
+    int sent = 0;
+    while (static_cast<int>(latencies.size()) < request_count) {
+        string batch;
+        while (sent < request_count && static_cast<int>(in_flight.size()) < pipeline_depth) {
+            const int word_count = uniform_int_distribution<int>(1, 3)(generator);
+            batch += "SEARCH "s + RandomText(generator, vocabulary_size, word_count) + "\n"s;
+            in_flight.push_back(Clock::now());
+            ++sent;
+        }
+        if (!batch.empty()) {
+            client.Send(batch);
+        }
+        const string response = client.ReadLine();
+        if (response.rfind("OK"s, 0) != 0) {
+            throw runtime_error("Unexpected response: "s + response);
+        }
+        latencies.push_back(chrono::duration_cast<chrono::microseconds>(Clock::now() - in_flight.front()).count());
+        in_flight.pop_front();
+    }
+    return latencies;
+}
+
+}  // namespace
+
+// load_test [port] [connections] [pipeline depth] [requests per connection] [documents to add]
+int main(int argc, char* argv[]) {
+    const uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8080;
+    const int connections = argc > 2 ? atoi(argv[2]) : 8;
+    const int pipeline_depth = argc > 3 ? atoi(argv[3]) : 16;
+    const int requests = argc > 4 ? atoi(argv[4]) : 10000;
+    const int documents = argc > 5 ? atoi(argv[5]) : 0;
+    const int vocabulary_size = 5000;
+
+    try {
+        if (documents > 0) {
+            Populate(port, documents, vocabulary_size);
+        }
+
+        vector<vector<int64_t>> results(connections);
+        vector<thread> threads;
+        const auto start = Clock::now();
+        for (int i = 0; i < connections; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    results[i] = RunConnection(port, requests, pipeline_depth, vocabulary_size, 100 + i);
+                }
+                catch (const exception& e) {
+                    cerr << "Connection "s << i << ": "s << e.what() << endl;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+        vector<int64_t> latencies;
+        for (const auto& result : results) {
+            latencies.insert(latencies.end(), result.begin(), result.end());
+        }
+        if (latencies.empty()) {
+            cerr << "No responses"s << endl;
+            return 1;
+        }
+        sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](double fraction) {
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))];
+        };
+
+        cout << "requests: "s << latencies.size() << ", seconds: "s << seconds
+            << ", throughput: "s << static_cast<int64_t>(latencies.size() / seconds) << " req/s"s << endl;
+        cout << "latency us: p50 = "s << percentile(0.5)
+            << ", p90 = "s << percentile(0.9)
+            << ", p99 = "s << percentile(0.99)
+            << ", p99.9 = "s << percentile(0.999)
+            << ", max = "s << latencies.back() << endl;
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "../query_server.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+namespace {
+QueryServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+}  // namespace
+
+// query_server [port] [threads] [stop words] [log path]
+// с журналом контрольная точка пишется в "<log path>.checkpoint"
+int main(int argc, char* argv[]) {
+    const uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8080;
+    const size_t threads = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : thread::hardware_concurrency();
+    const string stop_words = argc > 3 ? argv[3] : ""s;
+    const string log_path = argc > 4 ? argv[4] : ""s;
+
+    try {
+        SearchServer search_server(stop_words);
+        unique_ptr<WriteAheadLog> log;
+        if (!log_path.empty()) {
+            WriteAheadLogOptions options;
+            options.checkpoint_path = log_path + ".checkpoint"s;
+            log = make_unique<WriteAheadLog>(search_server, log_path, options);
+            cerr << "Recovered: "s << log->GetRecoveryStats() << endl;
+        }
+        QueryServer query_server(search_server, port, max<size_t>(threads, 1), log.get());
+
+        running_server = &query_server;
+        signal(SIGINT, HandleSignal);
+        signal(SIGTERM, HandleSignal);
+
+        cerr << "Listening on port "s << query_server.GetPort() << endl;
+        query_server.Run();
+        running_server = nullptr;
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,638 @@
+#include "write_ahead_log.h"
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <system_error>
+
+namespace {
+
+// заголовок файла: сигнатура и номер - первой записи журнала
+// или последней записи журнала, вошедшей в контрольную точку
+const std::string_view log_magic = "SSWALOG1";
+const std::string_view checkpoint_magic = "SSCKPNT1";
+const size_t file_header_size = 16;
+// заголовок записи: длина текста, CRC-32 номера и текста, номер; числа в порядке байтов машины
+const size_t record_header_size = 16;
+const size_t write_buffer_size = 1 << 20;
+
+void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+uint32_t UpdateCrc32(uint32_t crc, std::string_view data) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    crc = ~crc;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+template <typename T>
+T Load(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void Store(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t ComputeChecksum(uint64_t sequence, std::string_view payload) {
+    const std::string_view sequence_bytes(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+    return UpdateCrc32(UpdateCrc32(0, sequence_bytes), payload);
+}
+
+void EncodeRecord(std::string& out, uint64_t sequence, std::string_view payload) {
+    Store(out, static_cast<uint32_t>(payload.size()));
+    Store(out, ComputeChecksum(sequence, payload));
+    Store(out, sequence);
+    out += payload;
+}
+
+void AppendAddPayload(std::string& out,
+    int document_id,
+    std::string_view document,
+    DocumentStatus status,
+    const std::vector<int>& ratings) {
+    out += "ADD "s;
+    out += std::to_string(document_id);
+    out += ' ';
+    out += DocumentStatusToString(status);
+    out += ' ';
+    if (ratings.empty()) {
+        out += '-';
+    }
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += std::to_string(ratings[i]);
+    }
+    out += ' ';
+    out += document;
+}
+
+struct LogRecord {
+    uint64_t sequence;
+    uint32_t checksum;
+    std::string_view payload;
+};
+
+// отрезает заголовок файла и возвращает номер из него
+uint64_t ReadFileHeader(std::string_view& data, std::string_view magic, const std::string& path) {
+    if (data.size() < file_header_size || data.substr(0, magic.size()) != magic) {
+        throw std::invalid_argument("Invalid header of "s + path);
+    }
+    const auto sequence = Load<uint64_t>(data.data() + magic.size());
+    data.remove_prefix(file_header_size);
+    return sequence;
+}
+
+// записи с номерами подряд от first_sequence до первой оборванной или повреждённой;
+// возвращает длину верной части data
+size_t ScanRecords(std::string_view data, uint64_t first_sequence, std::vector<LogRecord>& records) {
+    size_t offset = 0;
+    while (data.size() - offset >= record_header_size) {
+        const char* header = data.data() + offset;
+        const auto size = Load<uint32_t>(header);
+        const auto sequence = Load<uint64_t>(header + 8);
+        if (size > data.size() - offset - record_header_size || sequence != first_sequence + records.size()) {
+            break;
+        }
+        records.push_back({ sequence, Load<uint32_t>(header + 4), data.substr(offset + record_header_size, size) });
+        offset += record_header_size + size;
+    }
+
+    // границы записей находятся по длинам, контрольные суммы проверяются параллельно
+    std::vector<char> valid(records.size());
+    std::transform(std::execution::par, records.begin(), records.end(), valid.begin(), [](const LogRecord& record) {
+        return static_cast<char>(ComputeChecksum(record.sequence, record.payload) == record.checksum);
+    });
+    records.resize(std::find(valid.begin(), valid.end(), 0) - valid.begin());
+    return records.empty() ? 0 : records.back().payload.data() + records.back().payload.size() - data.data();
+}
+
+struct ReplayOperation {
+    bool is_remove = false;
+    int document_id = 0;
+    SearchServer::PreparedDocument document;
+};
+
+struct ReplayBatch {
+    std::vector<ReplayOperation> operations;
+    size_t errors = 0;
+    std::string first_error;
+};
+
+ReplayOperation ParseRecord(const SearchServer& search_server, std::string_view payload) {
+    ReplayOperation operation;
+    const auto command = NextToken(payload);
+    if (command == "ADD") {
+        const int document_id = ParseInt(NextToken(payload));
+        const auto status = ParseDocumentStatus(NextToken(payload));
+        const auto ratings = ParseRatings(NextToken(payload));
+        // текст документа - после одного пробела, как был записан
+        if (!payload.empty()) {
+            payload.remove_prefix(1);
+        }
+        operation.document = search_server.PrepareDocument(document_id, payload, status, ratings);
+    }
+    else if (command == "REMOVE") {
+        operation.is_remove = true;
+        operation.document_id = ParseInt(NextToken(payload));
+    }
+    else {
+        throw std::invalid_argument("Unknown log record "s + std::string(command));
+    }
+    return operation;
+}
+
+void AddError(RecoveryStats& stats, const std::string& error) {
+    if (stats.errors++ == 0) {
+        stats.first_error = error;
+    }
+}
+
+// разбор пачек записей идёт в threads потоках, применение - в вызывающем в порядке records;
+// разобранными ждут не больше 2 * threads пачек. Возвращает число применённых записей
+size_t ReplayRecords(SearchServer& search_server,
+    const std::vector<LogRecord>& records,
+    const WriteAheadLogOptions& options,
+    RecoveryStats& stats) {
+    const size_t batch_size = options.recovery_batch_size;
+    const size_t batch_count = (records.size() + batch_size - 1) / batch_size;
+    const size_t window = 2 * options.recovery_threads;
+
+    std::vector<std::optional<ReplayBatch>> batches(batch_count);
+    std::mutex mutex;
+    std::condition_variable prepared;
+    std::condition_variable consumed;
+    size_t next_batch = 0;
+    size_t applied_batches = 0;
+
+    const auto prepare = [&] {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock(mutex);
+                consumed.wait(lock, [&] { return next_batch == batch_count || next_batch < applied_batches + window; });
+                if (next_batch == batch_count) {
+                    return;
+                }
+                index = next_batch++;
+            }
+
+            ReplayBatch batch;
+            const size_t end = std::min(records.size(), (index + 1) * batch_size);
+            for (size_t i = index * batch_size; i < end; ++i) {
+                try {
+                    batch.operations.push_back(ParseRecord(search_server, records[i].payload));
+                }
+                catch (const std::exception& e) {
+                    if (batch.errors++ == 0) {
+                        batch.first_error = e.what();
+                    }
+                }
+            }
+            {
+                std::lock_guard lock(mutex);
+                batches[index] = std::move(batch);
+            }
+            prepared.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(options.recovery_threads, batch_count); ++i) {
+        workers.emplace_back(prepare);
+    }
+
+    size_t applied = 0;
+    for (size_t index = 0; index < batch_count; ++index) {
+        ReplayBatch batch;
+        {
+            std::unique_lock lock(mutex);
+            prepared.wait(lock, [&] { return batches[index].has_value(); });
+            batch = std::move(*batches[index]);
+            batches[index].reset();
+            applied_batches = index + 1;
+        }
+        consumed.notify_all();
+
+        if (batch.errors > 0) {
+            AddError(stats, batch.first_error);
+            stats.errors += batch.errors - 1;
+        }
+        for (auto& operation : batch.operations) {
+            try {
+                if (operation.is_remove) {
+                    search_server.RemoveDocument(operation.document_id);
+                }
+                else {
+                    search_server.AddDocument(std::move(operation.document));
+                }
+                ++applied;
+            }
+            catch (const std::exception& e) {
+                AddError(stats, e.what());
+            }
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return applied;
+}
+
+bool FileExists(const std::string& path) {
+    return access(path.c_str(), F_OK) == 0;
+}
+
+// после rename запись каталога тоже должна попасть на диск
+void SyncDirectory(const std::string& path) {
+    const auto slash = path.rfind('/');
+    const std::string directory = slash == path.npos ? "."s : slash == 0 ? "/"s : path.substr(0, slash);
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowSystemError("Can't open "s + directory);
+    }
+    const int result = fsync(fd);
+    const int error = errno;
+    close(fd);
+    if (result < 0) {
+        throw std::system_error(error, std::generic_category(), "Can't sync "s + directory);
+    }
+}
+
+// возвращает 0 или errno
+int WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return 0;
+}
+
+// файл пишется рядом во временный и заменяет path только после fsync,
+// поэтому после сбоя на месте path остаётся либо старый файл, либо новый целиком
+class AtomicFileWriter {
+public:
+    AtomicFileWriter(const std::string& path, std::string_view magic, uint64_t sequence) :
+        path_(path), temp_path_(path + ".tmp"s) {
+        fd_ = open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            ThrowSystemError("Can't create "s + temp_path_);
+        }
+        buffer_ += magic;
+        Store(buffer_, sequence);
+    }
+
+    ~AtomicFileWriter() {
+        if (fd_ >= 0) {
+            close(fd_);
+            unlink(temp_path_.c_str());
+        }
+    }
+
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    void AppendRecord(uint64_t sequence, std::string_view payload) {
+        EncodeRecord(buffer_, sequence, payload);
+        if (buffer_.size() >= write_buffer_size) {
+            Flush();
+        }
+    }
+
+    void Commit() {
+        Flush();
+        if (fsync(fd_) < 0) {
+            ThrowSystemError("Can't sync "s + temp_path_);
+        }
+        close(fd_);
+        fd_ = -1;
+        if (rename(temp_path_.c_str(), path_.c_str()) < 0) {
+            ThrowSystemError("Can't rename "s + temp_path_);
+        }
+        SyncDirectory(path_);
+    }
+
+private:
+    const std::string path_;
+    const std::string temp_path_;
+    int fd_ = -1;
+    std::string buffer_;
+
+    void Flush() {
+        if (const int error = WriteAll(fd_, buffer_); error != 0) {
+            throw std::system_error(error, std::generic_category(), "Can't write "s + temp_path_);
+        }
+        buffer_.clear();
+    }
+};
+
+}  // namespace
+
+std::ostream& operator<<(std::ostream& out, const RecoveryStats& stats) {
+    out << "checkpoint documents = "s << stats.checkpoint_documents
+        << ", log records = "s << stats.log_records
+        << ", skipped = "s << stats.skipped_records
+        << ", errors = "s << stats.errors
+        << ", truncated bytes = "s << stats.truncated_bytes
+        << ", seconds = "s << stats.seconds;
+    if (!stats.first_error.empty()) {
+        out << ", first error: "s << stats.first_error;
+    }
+    return out;
+}
+
+WriteAheadLog::WriteAheadLog(SearchServer& search_server, const std::string& path, const WriteAheadLogOptions& options) :
+    path_(path), options_(options) {
+    if (options_.max_batch_bytes == 0 || options_.recovery_threads == 0 || options_.recovery_batch_size == 0) {
+        throw std::invalid_argument("Invalid write-ahead log options"s);
+    }
+    next_sequence_ = Recover(search_server);
+    durable_sequence_ = next_sequence_ - 1;
+
+    fd_ = open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd_ < 0) {
+        ThrowSystemError("Can't open "s + path_);
+    }
+    committer_ = std::thread(&WriteAheadLog::CommitLoop, this);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    commit_needed_.notify_one();
+    committer_.join();
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::Recover(SearchServer& search_server) {
+    const auto start = Clock::now();
+
+    uint64_t checkpoint_sequence = 0;
+    if (!options_.checkpoint_path.empty() && FileExists(options_.checkpoint_path)) {
+        const MappedFile file(options_.checkpoint_path);
+        auto data = file.GetData();
+        checkpoint_sequence = ReadFileHeader(data, checkpoint_magic, options_.checkpoint_path);
+        // контрольная точка появляется целиком, повреждение в ней - не оборванный хвост
+        std::vector<LogRecord> records;
+        if (ScanRecords(data, 1, records) != data.size()) {
+            throw std::invalid_argument("Corrupted checkpoint "s + options_.checkpoint_path);
+        }
+        recovery_stats_.checkpoint_documents = ReplayRecords(search_server, records, options_, recovery_stats_);
+    }
+
+    uint64_t next_sequence = checkpoint_sequence + 1;
+    if (!FileExists(path_)) {
+        AtomicFileWriter(path_, log_magic, next_sequence).Commit();
+    }
+    else {
+        size_t valid_size = 0;
+        {
+            const MappedFile file(path_);
+            auto data = file.GetData();
+            const size_t file_size = data.size();
+            const uint64_t first_sequence = ReadFileHeader(data, log_magic, path_);
+            if (first_sequence > next_sequence) {
+                throw std::invalid_argument("Write-ahead log "s + path_ + " starts after the checkpoint"s);
+            }
+
+            std::vector<LogRecord> records;
+            valid_size = file_header_size + ScanRecords(data, first_sequence, records);
+            recovery_stats_.truncated_bytes = file_size - valid_size;
+            next_sequence = std::max(next_sequence, first_sequence + records.size());
+
+            // записи до checkpoint_sequence остаются, если сбой был между записью точки и сбросом журнала
+            const auto first_new = std::partition_point(records.begin(), records.end(),
+                [checkpoint_sequence](const LogRecord& record) { return record.sequence <= checkpoint_sequence; });
+            recovery_stats_.skipped_records = first_new - records.begin();
+            records.erase(records.begin(), first_new);
+            recovery_stats_.log_records = ReplayRecords(search_server, records, options_, recovery_stats_);
+        }
+
+        if (recovery_stats_.truncated_bytes > 0) {
+            const int fd = open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+            if (fd < 0 || ftruncate(fd, static_cast<off_t>(valid_size)) < 0 || fdatasync(fd) < 0) {
+                const int error = errno;
+                if (fd >= 0) {
+                    close(fd);
+                }
+                throw std::system_error(error, std::generic_category(), "Can't truncate "s + path_);
+            }
+            close(fd);
+        }
+    }
+
+    recovery_stats_.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return next_sequence;
+}
+
+uint64_t WriteAheadLog::LogAddDocument(int document_id,
+    std::string_view document,
+    DocumentStatus status,
+    const std::vector<int>& ratings) {
+    std::string payload;
+    AppendAddPayload(payload, document_id, document, status, ratings);
+    return Append(payload);
+}
+
+uint64_t WriteAheadLog::LogRemoveDocument(int document_id) {
+    return Append("REMOVE "s + std::to_string(document_id));
+}
+
+uint64_t WriteAheadLog::Append(std::string_view payload) {
+    std::unique_lock lock(mutex_);
+    // пока пачка пишется на диск, следующая копится в памяти не больше max_batch_bytes
+    committed_.wait(lock, [this] {
+        return error_ != 0 || !committing_ || pending_.size() < options_.max_batch_bytes;
+    });
+    if (error_ != 0) {
+        throw std::system_error(error_, std::generic_category(), "Write-ahead log "s + path_ + " failed"s);
+    }
+
+    const uint64_t sequence = next_sequence_++;
+    if (pending_.empty()) {
+        first_pending_time_ = Clock::now();
+        commit_needed_.notify_one();
+    }
+    EncodeRecord(pending_, sequence, payload);
+    ++stats_.records;
+    if (pending_.size() >= options_.max_batch_bytes) {
+        commit_needed_.notify_one();
+    }
+    return sequence;
+}
+
+void WriteAheadLog::CommitLoop() {
+    std::string batch;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        commit_needed_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+        commit_needed_.wait_until(lock, first_pending_time_ + options_.max_commit_delay, [this] {
+            return stopping_ || sync_requested_ || pending_.size() >= options_.max_batch_bytes;
+        });
+
+        batch.swap(pending_);
+        pending_.clear();
+        const uint64_t batch_end = next_sequence_ - 1;
+        const int fd = fd_;
+        sync_requested_ = false;
+        committing_ = true;
+        lock.unlock();
+
+        int error = WriteAll(fd, batch);
+        if (error == 0 && fdatasync(fd) < 0) {
+            error = errno;
+        }
+
+        lock.lock();
+        committing_ = false;
+        if (error != 0) {
+            error_ = error;
+        }
+        else {
+            durable_sequence_ = batch_end;
+            ++stats_.commits;
+            stats_.bytes += batch.size();
+        }
+        committed_.notify_all();
+
+        // после ошибки сброса не дождётся ни одна из оставшихся записей
+        const auto ready_end = error != 0 ? durable_callbacks_.end() : durable_callbacks_.upper_bound(batch_end);
+        if (ready_end != durable_callbacks_.begin()) {
+            std::vector<DurableCallback> ready;
+            for (auto it = durable_callbacks_.begin(); it != ready_end; ++it) {
+                ready.push_back(std::move(it->second));
+            }
+            durable_callbacks_.erase(durable_callbacks_.begin(), ready_end);
+            lock.unlock();
+            for (const auto& callback : ready) {
+                callback(error);
+            }
+            lock.lock();
+        }
+    }
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence) {
+    std::unique_lock lock(mutex_);
+    if (sequence >= next_sequence_) {
+        throw std::invalid_argument("Unknown log sequence "s + std::to_string(sequence));
+    }
+    committed_.wait(lock, [this, sequence] { return durable_sequence_ >= sequence || error_ != 0; });
+    if (durable_sequence_ < sequence) {
+        throw std::system_error(error_, std::generic_category(), "Write-ahead log "s + path_ + " failed"s);
+    }
+}
+
+void WriteAheadLog::NotifyDurable(uint64_t sequence, DurableCallback callback) {
+    int error = 0;
+    {
+        std::lock_guard lock(mutex_);
+        if (sequence >= next_sequence_) {
+            throw std::invalid_argument("Unknown log sequence "s + std::to_string(sequence));
+        }
+        if (durable_sequence_ < sequence) {
+            if (error_ == 0) {
+                durable_callbacks_.emplace(sequence, std::move(callback));
+                return;
+            }
+            error = error_;
+        }
+    }
+    callback(error);
+}
+
+void WriteAheadLog::Sync() {
+    uint64_t sequence;
+    {
+        std::lock_guard lock(mutex_);
+        sequence = next_sequence_ - 1;
+        if (!pending_.empty()) {
+            sync_requested_ = true;
+            commit_needed_.notify_one();
+        }
+    }
+    if (sequence > 0) {
+        WaitDurable(sequence);
+    }
+}
+
+void WriteAheadLog::Checkpoint(const SearchServer& search_server) {
+    if (options_.checkpoint_path.empty()) {
+        throw std::invalid_argument("Checkpoint path is not set"s);
+    }
+    Sync();
+    const uint64_t sequence = GetDurableSequence();
+
+    AtomicFileWriter checkpoint(options_.checkpoint_path, checkpoint_magic, sequence);
+    uint64_t document_sequence = 1;
+    std::string payload;
+    for (const int document_id : search_server) {
+        const auto document = search_server.GetStoredDocument(document_id);
+        payload.clear();
+        AppendAddPayload(payload, document_id, document.text, document.status, { document.rating });
+        checkpoint.AppendRecord(document_sequence++, payload);
+    }
+    checkpoint.Commit();
+
+    // журнал начинается заново со следующего номера; сбой до этого места
+    // оставляет старый журнал, его записи до sequence пропускаются при восстановлении
+    AtomicFileWriter(path_, log_magic, sequence + 1).Commit();
+    const int fd = open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowSystemError("Can't open "s + path_);
+    }
+    std::lock_guard lock(mutex_);
+    close(fd_);
+    fd_ = fd;
+}
+
+const RecoveryStats& WriteAheadLog::GetRecoveryStats() const {
+    return recovery_stats_;
+}
+
+WriteAheadLogStats WriteAheadLog::GetStats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+uint64_t WriteAheadLog::GetDurableSequence() const {
+    std::lock_guard lock(mutex_);
+    return durable_sequence_;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "search_server.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Журнал изменений индекса (write-ahead log) для восстановления после сбоя.
+// Запись журнала - "ADD <id> <status> <rating,rating,...|-> <text>" или "REMOVE <id>"
+// с длиной, порядковым номером и контрольной суммой CRC-32.
+//
+// Групповая фиксация: записи копятся в памяти, отдельный поток сбрасывает их
+// одним write и fdatasync, когда с первой несброшенной записи прошло max_commit_delay
+// или накопилось max_batch_bytes. Log* возвращает номер записи, WaitDurable(номер)
+// ждёт её сброса - одна fdatasync подтверждает изменения всех потоков, успевших в пачку.
+// NotifyDurable(номер, callback) - то же без ожидания, для потоков с циклом событий.
+//
+// При открытии журнал восстанавливает индекс: сначала из контрольной точки
+// (снимок документов в том же формате записей), затем записи журнала после неё.
+// Записи разбираются в нескольких потоках, применяются к индексу в порядке журнала.
+// Недописанный при сбое хвост (обрывок или неверная контрольная сумма) отбрасывается.
+
+struct WriteAheadLogOptions {
+    std::chrono::microseconds max_commit_delay{ 1000 };
+    size_t max_batch_bytes = 1 << 20;
+    // пусто - контрольные точки не используются
+    std::string checkpoint_path;
+    size_t recovery_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t recovery_batch_size = 1024;
+};
+
+struct RecoveryStats {
+    size_t checkpoint_documents = 0;
+    size_t log_records = 0;
+    // записи журнала, уже вошедшие в контрольную точку
+    size_t skipped_records = 0;
+    size_t errors = 0;
+    // отброшенный повреждённый хвост журнала
+    size_t truncated_bytes = 0;
+    double seconds = 0.0;
+    std::string first_error;
+};
+
+std::ostream& operator<<(std::ostream& out, const RecoveryStats& stats);
+
+struct WriteAheadLogStats {
+    uint64_t records = 0;
+    uint64_t commits = 0;
+    uint64_t bytes = 0;
+};
+
+class WriteAheadLog {
+public:
+    // восстанавливает search_server из контрольной точки и журнала path
+    // (файл создаётся, если его нет) и открывает журнал для дозаписи
+    WriteAheadLog(SearchServer& search_server, const std::string& path, const WriteAheadLogOptions& options = {});
+    // сбрасывает накопленные записи на диск
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // вызывающий проверяет изменение (SearchServer::CheckDocument, HasDocument) и пишет его
+    // до применения к индексу, в том же порядке и под той же блокировкой, поэтому в журнал
+    // попадают только изменения, которые индекс примет. После ошибки записи журнала Log*
+    // бросает std::system_error, и индекс остаётся прежним. Запись, которую индекс всё же
+    // отклонил (например, std::bad_alloc при применении), так же отклоняется при
+    // восстановлении и учитывается в RecoveryStats::errors.
+    // Возвращают номер записи для WaitDurable
+    uint64_t LogAddDocument(int document_id,
+        std::string_view document,
+        DocumentStatus status,
+        const std::vector<int>& ratings);
+    uint64_t LogRemoveDocument(int document_id);
+
+    // ждёт, пока запись sequence и все предыдущие окажутся на диске;
+    // после ошибки записи журнала бросает std::system_error
+    void WaitDurable(uint64_t sequence);
+    // вызывает callback(0), когда запись sequence и все предыдущие окажутся на диске,
+    // или callback(код ошибки) после ошибки записи журнала. Вызов идёт из потока журнала
+    // вне его блокировки (для уже сброшенной записи - сразу из вызывающего потока),
+    // поэтому callback должен быть коротким и может обращаться к журналу
+    using DurableCallback = std::function<void(int error)>;
+    void NotifyDurable(uint64_t sequence, DurableCallback callback);
+    // сбрасывает все записи, не дожидаясь max_commit_delay
+    void Sync();
+
+    // записывает снимок документов в checkpoint_path (через временный файл и rename)
+    // и начинает журнал заново. Индекс не должен меняться во время вызова
+    void Checkpoint(const SearchServer& search_server);
+
+    const RecoveryStats& GetRecoveryStats() const;
+    WriteAheadLogStats GetStats() const;
+    uint64_t GetDurableSequence() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    RecoveryStats recovery_stats_;
+    int fd_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable commit_needed_;
+    std::condition_variable committed_;
+    // записи, ещё не переданные потоку фиксации
+    std::string pending_;
+    Clock::time_point first_pending_time_;
+    uint64_t next_sequence_ = 1;
+    uint64_t durable_sequence_ = 0;
+    bool sync_requested_ = false;
+    bool committing_ = false;
+    bool stopping_ = false;
+    int error_ = 0;
+    // ожидающие NotifyDurable по номеру записи
+    std::multimap<uint64_t, DurableCallback> durable_callbacks_;
+    WriteAheadLogStats stats_;
+    std::thread committer_;
+
+    // возвращает номер первой записи, которую примет журнал
+    uint64_t Recover(SearchServer& search_server);
+    uint64_t Append(std::string_view payload);
+    void CommitLoop();
+};